@@ -1,6 +1,7 @@
 #include <android/log.h>
 #include <android_native_app_glue.h>
 #include <memory>
+#include <string>
 #include <ParticleSystem.hpp>
 
 std::unique_ptr<vkm::ParticleSystem> particle;
@@ -19,7 +20,11 @@ void handle_cmd(android_app* app, int32_t cmd) {
         .exitOnError = false,
     };
 
-    particle = std::make_unique<vkm::ParticleSystem>(app, "vkLavaMpm", debugOption);
+    // The pipelines compiled by the driver are kept in the app storage, for the next launches
+    const std::string pipelineCacheFile = std::string(app->activity->internalDataPath) + "/pipeline_cache.bin";
+
+    particle = std::make_unique<vkm::ParticleSystem>(app, "vkLavaMpm", debugOption, vkm::SimulationConfig(),
+                                                     pipelineCacheFile);
 
     launch = true;
   } else if (cmd == APP_CMD_TERM_WINDOW) {
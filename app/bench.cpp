@@ -0,0 +1,233 @@
+// clang-format off
+#include <stdlib.h>                     // for EXIT_FAILURE, EXIT_SUCCESS
+#include <chrono>                       // for steady_clock, duration
+#include <cxxopts.hpp>                  // for OptionAdder, Options, ParseRe...
+#include <fstream>                      // for ofstream
+#include <iostream>                     // for operator<<, cout, cerr, endl
+#include <iterator>                     // for size
+#include <string>                       // for string
+#include <vector>                       // for vector
+#include <GpuProfiler.hpp>              // for GpuProfiler, GpuPass
+#include <HeadlessSimulation.hpp>       // for HeadlessSimulation
+#include <WorkgroupTuning.hpp>          // for WorkgroupTuning
+#include <SimulationConfig.hpp>         // for SimulationConfig
+#include <poike/poike.hpp>
+// clang-format on
+
+// Passes of the compute command buffer, the headless simulation has no graphics
+static constexpr vkm::GpuPass computePasses[] = {
+    vkm::GpuPass::ClearGrid,
+    vkm::GpuPass::P2G,
+    vkm::GpuPass::UpdateGrid,
+    vkm::GpuPass::G2P,
+};
+
+struct BenchResult {
+  vkm::SimulationConfig config;
+  uint32_t frames;
+  double seconds;
+  vkm::GpuProfiler::Stats passes[std::size(computePasses)];
+
+  inline double stepsPerSecond() const { return frames * config.substeps / seconds; }
+  inline double particleUpdatesPerSecond() const { return stepsPerSecond() * config.numParticles; }
+};
+
+static void writeJson(std::ostream& os, const std::vector<BenchResult>& results) {
+  os << "[\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+
+    os << "  {\"particles\": " << r.config.numParticles << ", \"grid\": " << r.config.gridResolution
+       << ", \"substeps\": " << r.config.substeps << ", \"frames\": " << r.frames << ", \"seconds\": " << r.seconds
+       << ", \"steps_per_second\": " << r.stepsPerSecond()
+       << ", \"particle_updates_per_second\": " << r.particleUpdatesPerSecond() << ", \"passes\": {";
+    for (size_t pass = 0; pass < std::size(computePasses); ++pass) {
+      os << (pass > 0 ? ", " : "") << "\"" << vkm::GpuProfiler::name(computePasses[pass])
+         << "\": {\"min\": " << r.passes[pass].min << ", \"avg\": " << r.passes[pass].avg
+         << ", \"p99\": " << r.passes[pass].p99 << "}";
+    }
+    os << "}}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  os << "]\n";
+}
+
+static void writeCsv(std::ostream& os, const std::vector<BenchResult>& results) {
+  os << "particles,grid,substeps,frames,seconds,steps_per_second,particle_updates_per_second";
+  for (vkm::GpuPass pass : computePasses) {
+    const std::string name = vkm::GpuProfiler::name(pass);
+    os << "," << name << "_min_ms," << name << "_avg_ms," << name << "_p99_ms";
+  }
+  os << "\n";
+
+  for (const BenchResult& r : results) {
+    os << r.config.numParticles << "," << r.config.gridResolution << "," << r.config.substeps << "," << r.frames
+       << "," << r.seconds << "," << r.stepsPerSecond() << "," << r.particleUpdatesPerSecond();
+    for (const vkm::GpuProfiler::Stats& stats : r.passes) {
+      os << "," << stats.min << "," << stats.avg << "," << stats.p99;
+    }
+    os << "\n";
+  }
+}
+
+int main(int argc, char** argv) {
+  cxxopts::Options options(argv[0], "Measure the throughput of the headless simulation");
+
+  // clang-format off
+  options.add_options()
+    ("h,help", "Show help")
+    ("d,debug", "Debug level (0: nothing, 1: error, 2: warning)", cxxopts::value<int>(), "LEVEL")
+    ("p2g", "Particle to grid scheme (serial, atomic, tiled)", cxxopts::value<std::string>()->default_value("atomic"), "MODE")
+    ("layout", "Particle storage on the GPU (aos, soa)", cxxopts::value<std::string>()->default_value("aos"), "LAYOUT")
+    ("grid-mode", "Grid storage on the GPU (dense, sparse)", cxxopts::value<std::string>()->default_value("dense"), "MODE")
+    ("pool-blocks", "Capacity of the sparse grid in blocks of 8x8 cells (0: the whole domain)", cxxopts::value<uint32_t>()->default_value("0"), "COUNT")
+    ("n,particles", "Comma separated particle counts", cxxopts::value<std::vector<uint32_t>>()->default_value("4096,16384,65536"), "COUNTS")
+    ("g,grid", "Comma separated grid resolutions", cxxopts::value<std::vector<uint32_t>>()->default_value("128,256"), "SIZES")
+    ("substeps", "Simulation steps per frame", cxxopts::value<uint32_t>()->default_value("1"), "COUNT")
+    ("dt", "Time step of one simulation step", cxxopts::value<float>()->default_value("0.1"), "SECONDS")
+    ("sort-interval", "Frames between two sorts of the particles by cell (0: never)", cxxopts::value<uint32_t>()->default_value("0"), "FRAMES")
+    ("fuse-passes", "Clear the grid with a fill and update it in G2P, two dispatches per step instead of four")
+    ("workgroup-size", "Invocations per workgroup of the particle and cell passes, instead of those tuned on the first run", cxxopts::value<uint32_t>()->default_value("256"), "COUNT")
+    ("gravity", "Acceleration of the particles along y, in cells per time unit squared", cxxopts::value<float>()->default_value("0.3"), "ACCEL")
+    ("pipeline-cache", "File keeping the compiled pipelines between runs, empty to compile them each time", cxxopts::value<std::string>()->default_value("vkMpm_pipeline_cache.bin"), "FILE")
+    ("warmup", "Frames run before the measure", cxxopts::value<uint32_t>()->default_value("64"), "COUNT")
+    ("steps", "Frames measured for each configuration", cxxopts::value<uint32_t>()->default_value("1000"), "COUNT")
+    ("format", "Output format (json, csv)", cxxopts::value<std::string>()->default_value("json"), "FORMAT")
+    ("o,output", "Output file, the standard output otherwise", cxxopts::value<std::string>(), "FILE");
+  ;
+  // clang-format on
+
+  auto result = options.parse(argc, argv);
+
+  if (result["help"].as<bool>()) {
+    std::cout << options.help();
+    return EXIT_SUCCESS;
+  }
+
+  vkm::SimulationConfig baseConfig = {
+      .substeps       = result["substeps"].as<uint32_t>(),
+      .dt             = result["dt"].as<float>(),
+      .sortInterval   = result["sort-interval"].as<uint32_t>(),
+      .fuseGridPasses = result["fuse-passes"].as<bool>(),
+      .workgroupSize  = result["workgroup-size"].as<uint32_t>(),
+      .gravity        = result["gravity"].as<float>(),
+  };
+
+  const std::string p2g = result["p2g"].as<std::string>();
+  if (p2g == "serial") {
+    baseConfig.p2gMode = vkm::P2GMode::Serial;
+  } else if (p2g == "atomic") {
+    baseConfig.p2gMode = vkm::P2GMode::Atomic;
+  } else if (p2g == "tiled") {
+    baseConfig.p2gMode = vkm::P2GMode::Tiled;
+  } else {
+    std::cerr << "Unknown particle to grid scheme: " << p2g << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string layout = result["layout"].as<std::string>();
+  if (layout == "aos") {
+    baseConfig.layout = vkm::ParticleLayout::AoS;
+  } else if (layout == "soa") {
+    baseConfig.layout = vkm::ParticleLayout::SoA;
+  } else {
+    std::cerr << "Unknown particle layout: " << layout << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string gridMode = result["grid-mode"].as<std::string>();
+  if (gridMode == "dense") {
+    baseConfig.gridMode = vkm::GridMode::Dense;
+  } else if (gridMode == "sparse") {
+    baseConfig.gridMode = vkm::GridMode::Sparse;
+  } else {
+    std::cerr << "Unknown grid mode: " << gridMode << std::endl;
+    return EXIT_FAILURE;
+  }
+  baseConfig.poolBlocks = result["pool-blocks"].as<uint32_t>();
+
+  const std::string format = result["format"].as<std::string>();
+  if (format != "json" && format != "csv") {
+    std::cerr << "Unknown output format: " << format << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const poike::DebugOption debugOption = {
+      .debugLevel  = result.count("debug") ? result["debug"].as<int>() : 0,
+      .exitOnError = false,
+  };
+
+  const uint32_t warmup = result["warmup"].as<uint32_t>();
+  const uint32_t steps  = result["steps"].as<uint32_t>();
+
+  // Each configuration loads the pipelines compiled by the previous ones
+  const std::string pipelineCache = result["pipeline-cache"].as<std::string>();
+
+  // The workgroup sizes of the passes are tuned by the first configuration, and kept next to the pipeline cache
+  const bool tuneWorkgroups        = result.count("workgroup-size") == 0 && !pipelineCache.empty();
+  const std::string workgroupsFile = vkm::WorkgroupTuning::filename(pipelineCache);
+
+  std::vector<BenchResult> results;
+
+  for (uint32_t numParticles : result["particles"].as<std::vector<uint32_t>>()) {
+    for (uint32_t gridResolution : result["grid"].as<std::vector<uint32_t>>()) {
+      vkm::SimulationConfig config = baseConfig;
+      config.numParticles          = numParticles;
+      config.gridResolution        = gridResolution;
+
+      try {
+        config.validate();
+      } catch (std::exception& e) {
+        std::cerr << "skip " << numParticles << " particles on a " << gridResolution << " grid: " << e.what()
+                  << std::endl;
+        continue;
+      }
+
+      try {
+        vkm::HeadlessSimulation simulation("vkMpm_bench", debugOption, config, pipelineCache);
+        if (tuneWorkgroups) config.stepWorkgroupSizes = simulation.useTunedWorkgroupSizes(workgroupsFile);
+
+        // Pipelines and caches warm, the timestamps are only sampled during the measure
+        simulation.run(warmup);
+
+        simulation.setProfiling(true);
+        const auto startTime = std::chrono::steady_clock::now();
+        simulation.run(steps);
+        const auto endTime = std::chrono::steady_clock::now();
+
+        BenchResult benchResult = {
+            .config  = config,
+            .frames  = steps,
+            .seconds = std::chrono::duration<double>(endTime - startTime).count(),
+        };
+        for (size_t pass = 0; pass < std::size(computePasses); ++pass) {
+          benchResult.passes[pass] = simulation.profiler().stats(computePasses[pass]);
+        }
+
+        std::cerr << numParticles << " particles, " << gridResolution << " grid: " << benchResult.stepsPerSecond()
+                  << " steps/s" << std::endl;
+        results.push_back(benchResult);
+      } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  std::ofstream file;
+  if (result.count("output")) {
+    file.open(result["output"].as<std::string>());
+    if (!file) {
+      std::cerr << "Can't open output file: " << result["output"].as<std::string>() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostream& os = file.is_open() ? static_cast<std::ostream&>(file) : std::cout;
+
+  if (format == "json") {
+    writeJson(os, results);
+  } else {
+    writeCsv(os, results);
+  }
+
+  return results.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
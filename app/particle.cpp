@@ -1,13 +1,111 @@
 // clang-format off
 #include <stdlib.h>                     // for EXIT_FAILURE, EXIT_SUCCESS
+#include <chrono>                       // for steady_clock, duration
 #include <cxxopts.hpp>                  // for OptionAdder, Options, ParseRe...
+#include <fstream>                      // for ofstream
 #include <iostream>                     // for operator<<, cout, endl, ostream
-#include <memory>                       // for allocator, shared_ptr
+#include <map>                          // for map
+#include <memory>                       // for allocator, unique_ptr
+#include <sstream>                      // for istringstream
 #include <ParticleSystem.hpp>  // for glfwInit, glfwTerminate, glfw...
+#include <HeadlessSimulation.hpp>       // for HeadlessSimulation
+#include <WorkgroupTuning.hpp>          // for WorkgroupTuning
+#include <Cpu/CpuSolver.hpp>            // for CpuSolver
+#include <struct/ComputeParticle.hpp>   // for ComputeParticle
 #include <string>                       // for string
+#include <thread>                       // for thread
+#include <vector>                       // for vector
 #include <poike/poike.hpp>
 // clang-format on
 
+// Write the timings as json or csv, depending on the extension of the file
+static bool writeProfile(const vkm::GpuProfiler& profiler, const std::string& filename) {
+  std::ofstream file(filename);
+  if (!file) {
+    std::cout << "Can't open profile file: " << filename << std::endl;
+    return false;
+  }
+
+  const std::string extension = ".json";
+  if (filename.size() >= extension.size()
+      && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0) {
+    profiler.writeJson(file);
+  } else {
+    profiler.writeCsv(file);
+  }
+  return true;
+}
+
+// Emitters separated by ';', each one box:X,Y,HALF_WIDTH,HALF_HEIGHT,VX,VY,RATE or disc:X,Y,RADIUS,VX,VY,RATE
+static bool parseEmitters(const std::string& specs, std::vector<vkm::Emitter>& emitters) {
+  std::istringstream specStream(specs);
+  std::string spec;
+  while (std::getline(specStream, spec, ';')) {
+    const size_t colon      = spec.find(':');
+    const std::string shape = spec.substr(0, colon);
+
+    std::vector<float> values;
+    std::istringstream valueStream(colon == std::string::npos ? "" : spec.substr(colon + 1));
+    std::string value;
+    while (std::getline(valueStream, value, ',')) {
+      try {
+        values.push_back(std::stof(value));
+      } catch (std::exception&) {
+        return false;
+      }
+    }
+
+    vkm::Emitter emitter;
+    if (shape == "box" && values.size() == 7) {
+      emitter = {
+          .center   = {values[0], values[1]},
+          .size     = {values[2], values[3]},
+          .velocity = {values[4], values[5]},
+          .shape    = vkm::EmitterShape::Box,
+          .rate     = static_cast<uint32_t>(values[6]),
+      };
+    } else if (shape == "disc" && values.size() == 6) {
+      emitter = {
+          .center   = {values[0], values[1]},
+          .size     = {values[2], values[2]},
+          .velocity = {values[3], values[4]},
+          .shape    = vkm::EmitterShape::Disc,
+          .rate     = static_cast<uint32_t>(values[5]),
+      };
+    } else {
+      return false;
+    }
+    emitters.push_back(emitter);
+  }
+  return true;
+}
+
+// Parameters of the instances separated by ';', each one LAMBDA,MU,DT
+static bool parseInstanceParameters(const std::string& specs, std::vector<vkm::ComputeParticle>& parameters) {
+  std::istringstream specStream(specs);
+  std::string spec;
+  while (std::getline(specStream, spec, ';')) {
+    std::vector<float> values;
+    std::istringstream valueStream(spec);
+    std::string value;
+    while (std::getline(valueStream, value, ',')) {
+      try {
+        values.push_back(std::stof(value));
+      } catch (std::exception&) {
+        return false;
+      }
+    }
+
+    if (values.size() != 3 || values[2] <= 0.0f) return false;
+    parameters.push_back({
+        .deltaT         = values[2],
+        .elastic_lambda = values[0],
+        .elastic_mu     = values[1],
+    });
+  }
+  return !parameters.empty();
+}
+
 int main(int argc, char** argv) {
   cxxopts::Options options(argv[0], "A program to simulate a lava flow !");
 
@@ -15,7 +113,37 @@ int main(int argc, char** argv) {
   options.add_options()
     ("h,help", "Show help")
     ("d,debug", "Debug level (0: nothing, 1: error, 2: warning)", cxxopts::value<int>(), "LEVEL")
-    ("e,error-exit", "Exit on first error");
+    ("e,error-exit", "Exit on first error")
+    ("p2g", "Particle to grid scheme (serial, atomic, tiled)", cxxopts::value<std::string>()->default_value("atomic"), "MODE")
+    ("layout", "Particle storage on the GPU (aos, soa)", cxxopts::value<std::string>()->default_value("aos"), "LAYOUT")
+    ("grid-mode", "Grid storage on the GPU (dense, sparse)", cxxopts::value<std::string>()->default_value("dense"), "MODE")
+    ("pool-blocks", "Capacity of the sparse grid in blocks of 8x8 cells (0: the whole domain)", cxxopts::value<uint32_t>()->default_value("0"), "COUNT")
+    ("n,particles", "Number of particles", cxxopts::value<uint32_t>()->default_value("4096"), "COUNT")
+    ("g,grid", "Grid resolution (cells per side)", cxxopts::value<uint32_t>()->default_value("64"), "SIZE")
+    ("substeps", "Simulation steps per frame", cxxopts::value<uint32_t>()->default_value("1"), "COUNT")
+    ("dt", "Time step of one simulation step", cxxopts::value<float>()->default_value("0.1"), "SECONDS")
+    ("sort-interval", "Frames between two sorts of the particles by cell (0: never)", cxxopts::value<uint32_t>()->default_value("0"), "FRAMES")
+    ("fuse-passes", "Clear the grid with a fill and update it in G2P, two dispatches per step instead of four")
+    ("workgroup-size", "Invocations per workgroup of the particle and cell passes, instead of those tuned on the first run", cxxopts::value<uint32_t>()->default_value("256"), "COUNT")
+    ("gravity", "Acceleration of the particles along y, in cells per time unit squared", cxxopts::value<float>()->default_value("0.3"), "ACCEL")
+    ("capacity", "Particles which fit in the buffers, for the emitters (0: the number of particles)", cxxopts::value<uint32_t>()->default_value("0"), "COUNT")
+    ("emitter", "Sources of particles separated by ';', box:X,Y,HALF_WIDTH,HALF_HEIGHT,VX,VY,RATE or disc:X,Y,RADIUS,VX,VY,RATE, in cells and particles per frame", cxxopts::value<std::string>(), "SPECS")
+    ("outflow", "Remove the particles which leave the domain through the edge the gravity pulls towards")
+    ("checkpoint", "File the state of the simulation is saved to, at exit and every checkpoint interval", cxxopts::value<std::string>(), "FILE")
+    ("checkpoint-interval", "Frames between two checkpoints (0: only at exit)", cxxopts::value<uint32_t>()->default_value("0"), "FRAMES")
+    ("restore", "Checkpoint file to continue the simulation from, saved with the same grid and layout", cxxopts::value<std::string>(), "FILE")
+    ("export", "File the positions and velocities of the particles are streamed to, every export interval", cxxopts::value<std::string>(), "FILE")
+    ("export-interval", "Frames between two exported frames", cxxopts::value<uint32_t>()->default_value("1"), "FRAMES")
+    ("export-quantize", "Export the positions and velocities as 16 bit integers instead of floats")
+    ("instances", "Independent simulations run by the same dispatches of the headless simulation", cxxopts::value<uint32_t>()->default_value("1"), "COUNT")
+    ("instance-parameters", "Parameters of each instance separated by ';', LAMBDA,MU,DT, instead of the same ones for all", cxxopts::value<std::string>(), "SPECS")
+    ("pipeline-cache", "File keeping the compiled pipelines between runs, empty to compile them each time", cxxopts::value<std::string>()->default_value("vkMpm_pipeline_cache.bin"), "FILE")
+    ("headless", "Run the simulation without window, then exit")
+    ("backend", "Backend of the headless simulation (gpu, cpu)", cxxopts::value<std::string>()->default_value("gpu"), "NAME")
+    ("threads", "Number of threads of the cpu backend (0: all cores)", cxxopts::value<uint32_t>()->default_value("0"), "COUNT")
+    ("simd", "Instruction set of the cpu backend (auto, scalar, sse, avx2, avx512)", cxxopts::value<std::string>()->default_value("auto"), "ISA")
+    ("profile", "Write the GPU timings of each pass to a file, as json if its extension is .json, csv otherwise", cxxopts::value<std::string>(), "FILE")
+    ("steps", "Number of frames of the headless simulation, each one made of the given substeps", cxxopts::value<uint32_t>()->default_value("1000"), "COUNT");
   ;
   // clang-format on
 
@@ -26,7 +154,79 @@ int main(int argc, char** argv) {
     return 0;
   }
 
-  vkm::ParticleSystem::initialize();
+  vkm::SimulationConfig config = {
+      .numParticles   = result["particles"].as<uint32_t>(),
+      .gridResolution = result["grid"].as<uint32_t>(),
+      .substeps       = result["substeps"].as<uint32_t>(),
+      .dt             = result["dt"].as<float>(),
+      .sortInterval   = result["sort-interval"].as<uint32_t>(),
+      .fuseGridPasses = result["fuse-passes"].as<bool>(),
+      .workgroupSize  = result["workgroup-size"].as<uint32_t>(),
+      .gravity        = result["gravity"].as<float>(),
+      .capacity       = result["capacity"].as<uint32_t>(),
+      .outflow        = result["outflow"].as<bool>(),
+      .instances      = result["instances"].as<uint32_t>(),
+  };
+
+  if (result.count("emitter") && !parseEmitters(result["emitter"].as<std::string>(), config.emitters)) {
+    std::cout << "Invalid emitter: " << result["emitter"].as<std::string>() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // one instance per set of parameters, unless their number is given
+  std::vector<vkm::ComputeParticle> instanceParameters;
+  if (result.count("instance-parameters")) {
+    if (!parseInstanceParameters(result["instance-parameters"].as<std::string>(), instanceParameters)) {
+      std::cout << "Invalid instance parameters: " << result["instance-parameters"].as<std::string>() << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (result.count("instances") == 0) {
+      config.instances = static_cast<uint32_t>(instanceParameters.size());
+    } else if (config.instances != instanceParameters.size()) {
+      std::cout << "The instance parameters don't match the number of instances" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  const std::string p2g = result["p2g"].as<std::string>();
+  if (p2g == "serial") {
+    config.p2gMode = vkm::P2GMode::Serial;
+  } else if (p2g == "atomic") {
+    config.p2gMode = vkm::P2GMode::Atomic;
+  } else if (p2g == "tiled") {
+    config.p2gMode = vkm::P2GMode::Tiled;
+  } else {
+    std::cout << "Unknown particle to grid scheme: " << p2g << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string layout = result["layout"].as<std::string>();
+  if (layout == "aos") {
+    config.layout = vkm::ParticleLayout::AoS;
+  } else if (layout == "soa") {
+    config.layout = vkm::ParticleLayout::SoA;
+  } else {
+    std::cout << "Unknown particle layout: " << layout << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string gridMode = result["grid-mode"].as<std::string>();
+  if (gridMode == "dense") {
+    config.gridMode = vkm::GridMode::Dense;
+  } else if (gridMode == "sparse") {
+    config.gridMode = vkm::GridMode::Sparse;
+  } else {
+    std::cout << "Unknown grid mode: " << gridMode << std::endl;
+    return EXIT_FAILURE;
+  }
+  config.poolBlocks = result["pool-blocks"].as<uint32_t>();
+
+  try {
+    config.validate();
+  } catch (std::exception& e) {
+    std::cout << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
 
   int debugLevel = 0;
   if (result.count("debug")) {
@@ -38,15 +238,141 @@ int main(int argc, char** argv) {
       .exitOnError = result.count("error-exit") > 0,
   };
 
-  vkm::ParticleSystem app("vkLavaMpm", debugOption);
+  const std::string profile       = result.count("profile") ? result["profile"].as<std::string>() : "";
+  const std::string pipelineCache = result["pipeline-cache"].as<std::string>();
+  const std::string checkpoint    = result.count("checkpoint") ? result["checkpoint"].as<std::string>() : "";
+  const std::string restore       = result.count("restore") ? result["restore"].as<std::string>() : "";
+  const uint32_t checkpointFrames = result["checkpoint-interval"].as<uint32_t>();
+  const std::string exportFile    = result.count("export") ? result["export"].as<std::string>() : "";
+  const uint32_t exportFrames     = result["export-interval"].as<uint32_t>();
+  const vkm::FrameEncoding exportEncoding
+      = result["export-quantize"].as<bool>() ? vkm::FrameEncoding::Quantized : vkm::FrameEncoding::Float;
+
+  // The workgroup sizes of the passes are tuned on the first run on a device, and kept next to the pipeline cache
+  const bool tuneWorkgroups        = result.count("workgroup-size") == 0 && !pipelineCache.empty();
+  const std::string workgroupsFile = vkm::WorkgroupTuning::filename(pipelineCache);
+
+  if (config.instances > 1 && (!result.count("headless") || !checkpoint.empty() || !restore.empty())) {
+    std::cout << "The instances only run headless, without checkpoints" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (result.count("headless")) {
+    const uint32_t steps      = result["steps"].as<uint32_t>();
+    const std::string backend = result["backend"].as<std::string>();
+    const uint32_t numThreads = result["threads"].as<uint32_t>();
+    const std::string simd    = result["simd"].as<std::string>();
+
+    try {
+      std::unique_ptr<vkm::ISolver> simulation;
+      vkm::HeadlessSimulation* gpuSimulation = nullptr;
+      if (backend == "gpu") {
+        auto headless = std::make_unique<vkm::HeadlessSimulation>("vkLavaMpm", debugOption, config, pipelineCache);
+        if (tuneWorkgroups) headless->useTunedWorkgroupSizes(workgroupsFile);
+        // after the tuning, which restarts the simulation
+        if (!restore.empty()) headless->restore(restore);
+        if (!checkpoint.empty()) headless->setCheckpoint(checkpoint, checkpointFrames);
+        if (!exportFile.empty()) headless->setExport(exportFile, exportFrames, exportEncoding);
+        for (uint32_t instance = 0; instance < instanceParameters.size(); ++instance) {
+          headless->setParameters(instance, instanceParameters[instance]);
+        }
+        headless->setProfiling(!profile.empty());
+        gpuSimulation = headless.get();
+        simulation    = std::move(headless);
+      } else if (backend == "cpu") {
+        if (!config.emitters.empty() || config.outflow) {
+          std::cout << "The cpu backend neither emits nor removes particles" << std::endl;
+          return EXIT_FAILURE;
+        }
+        if (!checkpoint.empty() || !restore.empty() || !exportFile.empty() || config.instances > 1) {
+          std::cout << "The cpu backend has neither checkpoints, frame export nor instances" << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        const std::map<std::string, vkm::SimdLevel> simdLevels = {
+            {"auto", vkm::SimdLevel::Auto}, {"scalar", vkm::SimdLevel::Scalar}, {"sse", vkm::SimdLevel::SSE},
+            {"avx2", vkm::SimdLevel::AVX2}, {"avx512", vkm::SimdLevel::AVX512},
+        };
+        if (simdLevels.count(simd) == 0) {
+          std::cout << "Unknown instruction set: " << simd << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        const uint32_t threads = numThreads > 0 ? numThreads : std::thread::hardware_concurrency();
+        auto solver            = std::make_unique<vkm::CpuSolver>(config, threads, simdLevels.at(simd));
+        std::cout << "cpu backend: " << solver->numThreads() << " threads, " << solver->kernels().name << " kernels"
+                  << std::endl;
+        simulation = std::move(solver);
+      } else {
+        std::cout << "Unknown backend: " << backend << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      const auto startTime = std::chrono::steady_clock::now();
+      simulation->run(steps);
+      const auto endTime = std::chrono::steady_clock::now();
+
+      const uint32_t totalSteps = steps * config.substeps;
+      if (config.instances > 1) std::cout << config.instances << " instances, ";
+      const double seconds      = std::chrono::duration<double>(endTime - startTime).count();
+      std::cout << totalSteps << " steps in " << seconds << " s (" << totalSteps / seconds << " steps/s)" << std::endl;
+
+      if (gpuSimulation != nullptr && gpuSimulation->checkpoint().failed()) {
+        std::cout << "Can't write checkpoint file: " << checkpoint << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      if (gpuSimulation != nullptr && gpuSimulation->exporter()) {
+        const vkm::FrameExporter& exporter = *gpuSimulation->exporter();
+        std::cout << exporter.written() << " frames exported, " << exporter.dropped() << " dropped" << std::endl;
+        if (exporter.failed()) {
+          std::cout << "Can't write frame file: " << exportFile << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+
+      if (!profile.empty()) {
+        if (gpuSimulation == nullptr) {
+          std::cout << "--profile only measures the gpu backend" << std::endl;
+        } else if (!writeProfile(gpuSimulation->profiler(), profile)) {
+          return EXIT_FAILURE;
+        }
+      }
+    } catch (std::exception& e) {
+      std::cout << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+  }
+
+  vkm::ParticleSystem::initialize();
+
+  vkm::ParticleSystem app("vkLavaMpm", debugOption, config, pipelineCache);
 
   try {
+    // tuned without window the first time only, the next runs find the sizes in the file
+    if (tuneWorkgroups && !app.useStoredWorkgroupSizes(workgroupsFile)) {
+      vkm::HeadlessSimulation tuner("vkLavaMpm", debugOption, config, pipelineCache);
+      app.setWorkgroupSizes(tuner.useTunedWorkgroupSizes(workgroupsFile));
+    }
+    if (!restore.empty()) app.restore(restore);
+    if (!checkpoint.empty()) app.setCheckpoint(checkpoint, checkpointFrames);
+    if (!exportFile.empty()) app.setExport(exportFile, exportFrames, exportEncoding);
     app.run();
   } catch (std::exception& e) {
     std::cout << e.what() << std::endl;
     return EXIT_FAILURE;
   }
 
+  if (app.checkpoint().failed()) {
+    std::cout << "Can't write checkpoint file: " << checkpoint << std::endl;
+  }
+
+  if (!profile.empty() && !writeProfile(app.profiler(), profile)) {
+    return EXIT_FAILURE;
+  }
+
   vkm::ParticleSystem::terminate();
 
   return EXIT_SUCCESS;
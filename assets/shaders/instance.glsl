@@ -0,0 +1,26 @@
+// Independent simulations batched in the same buffers, each pass covering all of them (see
+// SimulationConfig::instances). Instance i owns the particles from i * INSTANCE_CAPACITY, the cells of the dense grid
+// from i * INSTANCE_CELLS and its own parameters in the UBO. Declare GRID_RESOLUTION before the include.
+
+#ifndef INSTANCE_GLSL
+#define INSTANCE_GLSL
+
+layout(constant_id = 12) const int INSTANCES = 1;
+// Particles of the buffers of each instance
+layout(constant_id = 13) const int INSTANCE_CAPACITY = 1;
+
+const int INSTANCE_CELLS = GRID_RESOLUTION * GRID_RESOLUTION;
+
+// Parameters of a simulation, ComputeParticle, one per instance in the UBO
+struct Parameters {
+  float deltaT;
+  float elastic_lambda;
+  float elastic_mu;
+};
+
+// First cell of the grid of the instance being processed, added by gridIndex (see sparse_grid.glsl)
+int instanceCells = 0;
+
+int particleInstance(int index) { return index / INSTANCE_CAPACITY; }
+
+#endif
@@ -1,8 +1,13 @@
 #version 450
 
 layout(location = 0) in vec2 inPos;
+#ifdef SOA_LAYOUT
+// the vertex buffer is the position stream alone, see ParticlePosition
+const float inMass = 1.0;
+#else
 layout(location = 1) in vec2 inVel;
 layout(location = 2) in float inMass;
+#endif
 
 layout(binding = 0) uniform UBO {
   mat4 model;
@@ -0,0 +1,14 @@
+// Removal of the particles which leave the domain through its open edge (see SimulationConfig::outflow), at the start
+// of a submission: remove_mark.comp lists them, remove_holes.comp lists those before the new end of the particles, and
+// remove_fill.comp moves the live particles after it into these holes. The live particles stay the first ones of the
+// buffers, and particle_count.comp counts them.
+
+layout(constant_id = 7) const float GRAVITY = 0.3;
+
+// Past the slip boundary of the edge the gravity pulls towards (see update_grid.comp), where G2P keeps the particles
+// until they are removed
+bool outOfDomain(vec2 pos) { return GRAVITY > 0 ? pos.y > GRID_RESOLUTION - 3 : pos.y < 2; }
+
+// Lists of the removal, in the ParticleCount block
+int removedParticle(int i) { return removal[i]; }
+int hole(int i) { return removal[capacity + i]; }
@@ -0,0 +1,16 @@
+// Buffers of the particle sort, a counting sort on the Morton code of the particle cells (see sort_*.comp).
+
+// Number of keys: the grid resolution rounded up to a power of two, squared
+layout(constant_id = 4) const int SORT_KEYS = 1;
+
+// Histogram of the keys, turned into the first sorted index of each key, then the key and the rank among the
+// particles of the same key of each particle
+layout(set = 0, binding = 8) buffer SortData { int sortData[]; };
+
+struct SortedParticle {
+  Particle p;
+  mat2 F;
+};
+
+// Particles and deformation gradients in sorted order, copied back by sort_gather.comp
+layout(set = 0, binding = 9) buffer SortScratch { SortedParticle scratch[]; };
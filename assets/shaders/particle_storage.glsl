@@ -0,0 +1,90 @@
+// Particle storage shared by the compute shaders: one array of Particle, or with SOA_LAYOUT one array per member,
+// and the number of live particles.
+// Define PARTICLE_ACCESS (readonly) before the include for the shaders which don't write the particles, and
+// PARTICLE_INIT for the initialisation shaders, which also write the mass and the initial volume.
+
+#ifndef PARTICLE_ACCESS
+#define PARTICLE_ACCESS
+#endif
+
+#ifdef PARTICLE_INIT
+#define MASS_VOLUME_ACCESS
+#else
+#define MASS_VOLUME_ACCESS readonly
+#endif
+
+// Live particles, the first particleCount of the particle buffers, then the indirect commands which cover them (see
+// particle_count.comp)
+layout(set = 0, binding = 10) buffer ParticleCount {
+  int particleCount;
+  int capacity;  // particles which fit in the buffers
+
+  // Since the last count: the particles removed, the holes they leave and those filled (see particle_remove.glsl),
+  // then the particles emitted (see emit_particles.comp)
+  int removed;
+  int holes;
+  int moved;
+  int emitted;
+  uint sequence;  // particles emitted since the initialisation
+
+  uint dispatches[3 * 3];  // VkDispatchIndirectCommand of the default, P2G and G2P workgroup sizes
+  uint draw[4];            // VkDrawIndirectCommand of the render pass
+
+  // With SimulationConfig::outflow, the indices of the removed particles then of the holes, capacity of each
+  int removal[];
+};
+
+struct Particle {
+  mat2 C;
+  vec2 pos;
+  vec2 vel;
+  float mass;
+  float volume_0;
+  vec2 padding;
+};
+
+#ifdef SOA_LAYOUT
+
+// binding 0 is also the vertex buffer, so the render pass only fetches the positions
+layout(set = 0, binding = 0) buffer PARTICLE_ACCESS Positions { vec2 positions[]; };
+layout(set = 0, binding = 5) buffer PARTICLE_ACCESS Velocities { vec2 velocities[]; };
+layout(set = 0, binding = 6) buffer PARTICLE_ACCESS Affines { mat2 affines[]; };
+layout(set = 0, binding = 7) buffer MASS_VOLUME_ACCESS MassVolumes { vec2 massVolumes[]; };
+
+Particle loadParticle(int index) {
+  Particle p;
+  p.C        = affines[index];
+  p.pos      = positions[index];
+  p.vel      = velocities[index];
+  p.mass     = massVolumes[index].x;
+  p.volume_0 = massVolumes[index].y;
+  return p;
+}
+
+// mass and volume_0 never change after the initialisation
+void storeParticle(int index, Particle p) {
+  affines[index]    = p.C;
+  positions[index]  = p.pos;
+  velocities[index] = p.vel;
+}
+
+#ifdef PARTICLE_INIT
+void storeInitialParticle(int index, Particle p) {
+  storeParticle(index, p);
+  massVolumes[index] = vec2(p.mass, p.volume_0);
+}
+#endif
+
+#else
+
+layout(set = 0, binding = 0) buffer PARTICLE_ACCESS Pos { Particle particles[]; };
+
+Particle loadParticle(int index) { return particles[index]; }
+
+void storeParticle(int index, Particle p) { particles[index] = p; }
+
+#ifdef PARTICLE_INIT
+void storeInitialParticle(int index, Particle p) { particles[index] = p; }
+#endif
+
+#endif
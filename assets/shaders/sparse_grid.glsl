@@ -0,0 +1,53 @@
+// Grid indexing shared by the compute shaders. With SPARSE_GRID the grid buffer is a pool of BLOCK_SIDE x BLOCK_SIDE
+// cell blocks, given each step to the blocks touched by the particles (see mark_blocks.comp), otherwise it holds every
+// cell of the domain, for each instance (see instance.glsl). Declare GRID_RESOLUTION before the include.
+
+#include "instance.glsl"
+
+layout(constant_id = 2) const bool SPARSE_GRID = false;
+// Capacity of the pool, in blocks
+layout(constant_id = 3) const int POOL_BLOCKS = 1;
+
+const int BLOCK_SIDE    = 8;
+const int BLOCK_CELLS   = BLOCK_SIDE * BLOCK_SIDE;
+const int DOMAIN_BLOCKS = GRID_RESOLUTION / BLOCK_SIDE;  // per side
+
+// Indirect dispatch of the block passes (over the cells of the active blocks, see mark_blocks.comp), blocks which asked
+// for a slot, then the slot of each block of the domain (-1: none) followed by the block of each slot
+layout(set = 0, binding = 4) buffer Blocks {
+  uint groupsX;
+  uint groupsY;
+  uint groupsZ;
+  int activeBlocks;
+  int blockData[];
+};
+
+// Index in the grid buffer of a cell, -1 when its block didn't get a slot
+int gridIndex(ivec2 cell) {
+  if (!SPARSE_GRID) return instanceCells + cell.x * GRID_RESOLUTION + cell.y;
+
+  const ivec2 block = cell / BLOCK_SIDE;
+  const int slot    = blockData[block.x * DOMAIN_BLOCKS + block.y];
+  if (slot < 0) return -1;
+
+  const ivec2 local = cell % BLOCK_SIDE;
+  return slot * BLOCK_CELLS + local.x * BLOCK_SIDE + local.y;
+}
+
+// Cell of an index of the grid buffer, (-1, -1) past the domain or the allocated blocks
+ivec2 gridCell(int index) {
+  if (!SPARSE_GRID) {
+    if (index >= INSTANCES * INSTANCE_CELLS) return ivec2(-1);
+    // the grids of the instances follow each other
+    index %= INSTANCE_CELLS;
+    return ivec2(index / GRID_RESOLUTION, index % GRID_RESOLUTION);
+  }
+
+  const int slot = index / BLOCK_CELLS;
+  if (slot >= min(activeBlocks, POOL_BLOCKS)) return ivec2(-1);
+
+  const int block = blockData[DOMAIN_BLOCKS * DOMAIN_BLOCKS + slot];
+  const int local = index % BLOCK_CELLS;
+  return ivec2(block / DOMAIN_BLOCKS, block % DOMAIN_BLOCKS) * BLOCK_SIDE
+         + ivec2(local / BLOCK_SIDE, local % BLOCK_SIDE);
+}
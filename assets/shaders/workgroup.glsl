@@ -0,0 +1,7 @@
+// Workgroup of the particle and cell passes, its size is set by ComputePipeline (see SimulationConfig::workgroupSize)
+// so that each device gets its best one. The dispatches cover the invocations with a partial last workgroup, whose
+// extra invocations are discarded by the shaders.
+
+layout(local_size_x_id = 6) in;
+
+const int WORKGROUP_SIZE = int(gl_WorkGroupSize.x);
@@ -2,18 +2,30 @@
 # This function compile any GLSL shader into SPIR-V shader and embed it in a C header file.
 # Example:
 #	compile_shaders(TARGETS "assets/shader/basic.frag" "assets/shader/basic.vert")
+#
+# A variant of the shaders can be built with preprocessor definitions, its header and global get the suffix:
+#	compile_shaders(TARGETS "assets/shader/basic.vert" SUFFIX "soa" DEFINES "SOA_LAYOUT")
+#	-> include/basic_vert_soa.h, BASIC_VERT_SOA
 ####################################################################################################
 
 function(compile_shaders)
 
 	include(CMakeParseArguments)
-    cmake_parse_arguments(SHADERS "" "" "TARGETS" ${ARGN})
+    cmake_parse_arguments(SHADERS "" "SUFFIX" "TARGETS;DEFINES" ${ARGN})
 
 	# Note: if it remains unparsed arguments, here, they can be found in variable PARSED_ARGS_UNPARSED_ARGUMENTS
-	if(NOT SHADERS)
+	if(NOT SHADERS_TARGETS)
 		message(FATAL_ERROR "You must provide targets.")
 	endif()
 
+	set(glslDefines "")
+	foreach(DEFINE ${SHADERS_DEFINES})
+		list(APPEND glslDefines "-D${DEFINE}")
+	endforeach()
+
+	# Files included by the shaders, any change rebuilds them all
+	file(GLOB SHADER_INCLUDES "${ROOT_DIR}/assets/shaders/*.glsl")
+
 	# Find the glslangValidator executable
 	if(WIN32)
 		set(glslCompiler "${CMAKE_RUNTIME_OUTPUT_DIRECTORY}/glslangValidator.exe")
@@ -22,11 +34,16 @@ function(compile_shaders)
 	endif()
 
 	# For each shader, we create a header file
-	foreach(SHADER ${SHADERS})
+	foreach(SHADER ${SHADERS_TARGETS})
 
 		# Prepare a header name and a global variable for this shader
 		get_filename_component(SHADER_NAME ${SHADER} NAME)
 		string(REPLACE "." "_" HEADER_NAME ${SHADER_NAME})
+		set(SHADER_SPV "${SHADER}.spv")
+		if(SHADERS_SUFFIX)
+			set(HEADER_NAME "${HEADER_NAME}_${SHADERS_SUFFIX}")
+			set(SHADER_SPV "${SHADER}.${SHADERS_SUFFIX}.spv")
+		endif()
 		string(TOUPPER ${HEADER_NAME} GLOBAL_SHADER_VAR)
 
 		set(SHADER_HEADER "${ROOT_DIR}/include/${HEADER_NAME}.h")
@@ -34,16 +51,16 @@ function(compile_shaders)
 		add_custom_target(
 			${HEADER_NAME}
 			# Compile any GLSL shader into SPIR-V shader
-			COMMAND ${glslCompiler} -V ${SHADER} -o ${SHADER}.spv
+			COMMAND ${glslCompiler} -V ${glslDefines} ${SHADER} -o ${SHADER_SPV}
 			# Make a C header file with the SPIR-V shader
-			COMMAND ${CMAKE_COMMAND} -DPATH="${SHADER}.spv" -DHEADER="${SHADER_HEADER}" -DGLOBAL="${GLOBAL_SHADER_VAR}" -P "${ROOT_DIR}/cmake/scripts/embed-data.cmake"
+			COMMAND ${CMAKE_COMMAND} -DPATH="${SHADER_SPV}" -DHEADER="${SHADER_HEADER}" -DGLOBAL="${GLOBAL_SHADER_VAR}" -P "${ROOT_DIR}/cmake/scripts/embed-data.cmake"
 			# Rebuild the header file if the shader is updated
-			DEPENDS ${SHADER}
-			COMMENT "Building ${SHADER}.spv and embedding it into ${SHADER_HEADER}"
+			DEPENDS ${SHADER} ${SHADER_INCLUDES}
+			COMMENT "Building ${SHADER_SPV} and embedding it into ${SHADER_HEADER}"
 		)
 
-		# Add the custom target like a dependencies of the project
-		add_dependencies(${PROJECT_NAME} ${HEADER_NAME})
+		# Add the custom target like a dependencies of the library which embeds the shaders
+		add_dependencies(${CORE_TARGET} ${HEADER_NAME})
 
 		message(STATUS "Generating build commands for ${SHADER}")
 	endforeach()
@@ -0,0 +1,103 @@
+/**
+ * @file Checkpoint.hpp
+ * @brief Define Checkpoint class
+ *
+ * State of the simulation saved to a binary file, to resume a run or fork experiments from it: the live particles,
+ * their deformation gradients, and the parameters of the compute passes. The grid is rebuilt by each step, so it isn't
+ * saved.
+ */
+
+#pragma once
+
+#include <poike/poike.hpp>
+#include <Compute/ComputeCommandBuffer.hpp>  // for ComputeCommandBuffer
+#include <SimulationConfig.hpp>              // for SimulationConfig
+#include <struct/ComputeParticle.hpp>        // for ComputeParticle
+#include <atomic>                            // for atomic
+#include <cstdint>                           // for uint32_t
+#include <istream>                           // for istream
+#include <optional>                          // for optional
+#include <string>                            // for string
+#include <thread>                            // for thread
+
+using namespace poike;
+
+namespace vkm {
+
+  // Start of a checkpoint file, followed by the live particles of each stream of MPMStorageBuffer::particleStreams, in
+  // the byte order of the host
+  struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;  // ParticleLayout, which gives the streams
+    uint32_t gridResolution;
+    uint32_t count;
+    uint32_t sequence;  // particles emitted so far, see ParticleCounter
+    uint32_t padding;
+    ComputeParticle parameters;
+  };
+
+  class Checkpoint : public NoCopy {
+  public:
+    static constexpr char magic[8] = {'v', 'k', 'M', 'p', 'm', 'C', 'k', 'p'};
+    // Changed with the layout of the file, the files of another version are rejected
+    static constexpr uint32_t version = 1;
+
+    Checkpoint(const Device& device,
+               const CommandPool& commandPool,
+               const ComputeCommandBuffer& commandBuffer,
+               const SimulationConfig& config);
+    // Waits for the checkpoint being written, if any
+    ~Checkpoint();
+
+    // Copy the state to a staging buffer on the compute queue, after the steps submitted so far, then write it to the
+    // file from another thread: the simulation goes on meanwhile. Returns false, without saving, while the previous
+    // checkpoint is still being written.
+    bool save(const std::string& filename, const ComputeParticle& parameters);
+
+    // Whether a checkpoint is still being written. Releases its staging buffer once it is done.
+    bool writing();
+
+    // Block until the checkpoint being written, if any, is in its file, then release its staging buffer
+    void wait();
+
+    // Whether the last checkpoint written couldn't be, its file is then left as it was
+    inline bool failed() const { return m_failed; }
+
+    // Upload the state of the file on the compute queue, read straight into a mapped staging buffer, then wait for it.
+    // The device must be idle. Returns the parameters of the checkpoint, and throws if the file can't be read or was
+    // saved with another particle layout or grid.
+    ComputeParticle load(const std::string& filename) const;
+
+    // The staging buffer of a copy to the file: the counter, then each stream up to the capacity. Only the live
+    // particles are written. Returns false if it couldn't be.
+    static bool write(const std::string& filename,
+                      const char* data,
+                      const SimulationConfig& config,
+                      const ComputeParticle& parameters);
+
+    // The header of a checkpoint file opened for reading, which leaves it at the first stream. Throws if it isn't a
+    // checkpoint of this version, or doesn't fit the particle layout, grid and capacity of the config.
+    static CheckpointHeader readHeader(std::istream& file, const std::string& filename, const SimulationConfig& config);
+
+  private:
+    const Device& m_device;
+    const CommandPool& m_commandPool;
+    const ComputeCommandBuffer& m_commandBuffer;
+    const SimulationConfig& m_config;
+
+    // The checkpoint being written: the copy submitted with its fence, and the thread which waits for it then writes
+    // the file
+    std::optional<StorageBuffer> m_staging;
+    VkCommandBuffer m_copyCommand = VK_NULL_HANDLE;
+    VkFence m_copyFence           = VK_NULL_HANDLE;
+    void* m_stagingData           = nullptr;
+    std::thread m_writer;
+    std::atomic<bool> m_written = false;
+    std::atomic<bool> m_failed  = false;
+
+    // Wait for the writer thread, and free what the checkpoint used
+    void release();
+  };
+
+}  // namespace vkm
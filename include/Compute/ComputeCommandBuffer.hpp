@@ -3,6 +3,11 @@
 
 #include <poike/poike.hpp>
 #include <Compute/ComputePipeline.hpp>
+#include <Compute/ComputeDescriptorSets.hpp>
+#include <Compute/MPMStorageBuffer.hpp>
+#include <GpuProfiler.hpp>
+#include <SimulationConfig.hpp>
+#include <struct/ParticleCounter.hpp>
 #include <vector>
 
 using namespace poike;
@@ -12,29 +17,92 @@ namespace vkm {
   class ComputeCommandBuffer : public NoCopy {
   public:
     ComputeCommandBuffer(const Device& device,
-                         const RenderPass& renderPass,
                          const ComputePipeline& computePipeline,
                          const std::vector<const IBuffer*>& storageBuffers,
                          const CommandPool& commandPool,
-                         const DescriptorSets& descriptorSets);
+                         const ComputeDescriptorSets& descriptorSets,
+                         const SimulationConfig& config,
+                         const GpuProfiler* profiler = nullptr,
+                         const std::vector<const IBuffer*>& renderBuffers = {});
     void recreate();
 
-    inline VkCommandBuffer& command() { return m_commandBuffer; }
-    inline const VkCommandBuffer& command() const { return m_commandBuffer; }
+    // Place the particles of the configuration in their initial box and estimate their volume, and upload the emitters,
+    // on the compute queue, then wait for it
+    void initialise() const;
+
+    // Replace the live particles by the given number of them, stream after stream in the staging buffer (see
+    // MPMStorageBuffer::particleStreams), on the compute queue, then wait for it
+    void restore(const IBuffer& staging, uint32_t count, uint32_t sequence) const;
+
+    // record the copy of the counter then of the given particle streams, up to the capacity, to a host visible buffer,
+    // after the steps submitted before it
+    void recordStateCopy(VkCommandBuffer cmdBuffer,
+                         const IBuffer& staging,
+                         const std::vector<MPMStorageBuffer::ParticleStream>& streams) const;
+
+    // Copy the particles into the given render buffer and hand it to the graphics queue, then wait for it
+    void fillRenderBuffer(size_t renderBuffer) const;
+
+    inline VkCommandBuffer& command() { return m_commandBuffers[0]; }
+    inline const VkCommandBuffer& command() const { return m_commandBuffers[0]; }
+
+    // The command buffer to submit for the given frame: the one which writes the render buffer of the frame, and which
+    // first sorts the particles every sortInterval frames
+    inline const VkCommandBuffer& command(uint64_t frame) const {
+      const std::vector<VkCommandBuffer>& cmdBuffers
+          = (m_config.sortInterval > 0 && frame % m_config.sortInterval == 0) ? m_sortedCommandBuffers
+                                                                             : m_commandBuffers;
+      return cmdBuffers[frame % cmdBuffers.size()];
+    }
 
   protected:
-    VkCommandBuffer m_commandBuffer;
+    // One per render buffer, or a single one without render buffers
+    std::vector<VkCommandBuffer> m_commandBuffers;
+    std::vector<VkCommandBuffer> m_sortedCommandBuffers;
 
     const Device& m_device;
-    const RenderPass& m_renderPass;
     const ComputePipeline& m_computePipeline;
     const std::vector<const IBuffer*>& m_storageBuffers;
+    const std::vector<const IBuffer*> m_renderBuffers;  // empty for the headless simulation
     const CommandPool& m_commandPool;
-    const DescriptorSets& m_descriptorSets;
+    const ComputeDescriptorSets& m_descriptorSets;
+    const SimulationConfig& m_config;
+    const GpuProfiler* m_profiler;  // optional, writes a timestamp after each pass
 
     void createCommandBuffers();
     void destroyCommandBuffers();
 
+    // record the substeps, after a sort of the particles if requested, then the copy to the given render buffer if any,
+    // with the given descriptor set
+    VkCommandBuffer recordCommandBuffer(bool sort, const IBuffer* renderBuffer, size_t descriptorSet) const;
+
+    // record the copy of the particles to a render buffer, and its release to the graphics queue
+    void recordRenderCopy(VkCommandBuffer cmdBuffer, const IBuffer& renderBuffer) const;
+
+    // record one simulation step: clear grid, P2G, update grid and G2P
+    void recordStep(VkCommandBuffer cmdBuffer, uint32_t substep) const;
+
+    // record a counting sort of the particles and their deformation gradient by the Morton code of their cell
+    void recordSort(VkCommandBuffer cmdBuffer) const;
+
+    // record a dispatch over the cells, or over the active blocks of the sparse grid
+    void recordGridDispatch(VkCommandBuffer cmdBuffer, StepPass pass) const;
+
+    // record the removal of the particles which left the domain through the open edge, the last ones take their place
+    void recordRemove(VkCommandBuffer cmdBuffer) const;
+
+    // record the emission of the particles of the emitters of the configuration, after the live ones
+    void recordEmit(VkCommandBuffer cmdBuffer) const;
+
+    // record the indirect commands of the live particles, from their count
+    void recordParticleCount(VkCommandBuffer cmdBuffer) const;
+
+    // record a dispatch over the live particles, with the workgroup size of the given passes
+    void recordParticleDispatch(VkCommandBuffer cmdBuffer, ParticleDispatch dispatch) const;
+
+    // record the rebuild of the active blocks of the sparse grid, from the particle positions
+    void recordMarkBlocks(VkCommandBuffer cmdBuffer) const;
+
     // allocate one command buffer
     VkCommandBuffer allocCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false) const;
   };
@@ -2,31 +2,52 @@
 #define COMPUTEDESCRIPTORSETS_HPP
 
 #include <poike/poike.hpp>
-#include <vector>  
+#include <vector>
 
 using namespace poike;
 
 namespace vkm {
 
-  class ComputeDescriptorSets : public DescriptorSets {
+  class ComputeDescriptorSets : public NoCopy {
   public:
     ComputeDescriptorSets(const Device& device,
-                          const SwapChain& swapChain,
                           const DescriptorSetLayout& descriptorSetLayout,
                           const DescriptorPool& descriptorPool,
                           const std::vector<const IBuffer*>& buffers,
-                          const std::vector<const IUniformBuffers*>& uniformBuffers)
-        : DescriptorSets(device,
-                         swapChain,
-                         descriptorSetLayout,
-                         descriptorPool,
-                         buffers,
-                         uniformBuffers) {
+                          const std::vector<const IBuffer*>& uniformBuffers)
+        : m_device(device),
+          m_descriptorSetLayout(descriptorSetLayout),
+          m_descriptorPool(descriptorPool),
+          m_buffers(buffers),
+          m_uniformBuffers(uniformBuffers) {
       createDescriptorSets();
     }
 
+    void recreate() { createDescriptorSets(); }
+
+    // The uniform buffer keeps binding 3, the storage buffers take the others in order
+    static constexpr uint32_t uniformBinding = 3;
+    static inline uint32_t storageBinding(size_t i) {
+      return static_cast<uint32_t>(i < uniformBinding ? i : i + 1);
+    }
+
+    // Layout matching the storage buffers, without binding for the null ones, and the uniform buffer
+    static std::vector<VkDescriptorSetLayoutBinding> layoutBindings(const std::vector<const IBuffer*>& buffers);
+
+    // One set per copy of the uniform buffer, the storage buffers are the same in all of them
+    inline const VkDescriptorSet& descriptor(size_t i) const { return m_descriptorSets[i]; }
+    inline size_t size() const { return m_descriptorSets.size(); }
+
   private:
-    void createDescriptorSets() final;
+    std::vector<VkDescriptorSet> m_descriptorSets;
+
+    const Device& m_device;
+    const DescriptorSetLayout& m_descriptorSetLayout;
+    const DescriptorPool& m_descriptorPool;
+    const std::vector<const IBuffer*>& m_buffers;
+    const std::vector<const IBuffer*> m_uniformBuffers;
+
+    void createDescriptorSets();
   };
 }  // namespace vkm
 
@@ -3,29 +3,92 @@
 #define COMPUTEPIPELINE_HPP
 
 #include <poike/poike.hpp>
+#include <PipelineCache.hpp>
+#include <SimulationConfig.hpp>
+#include <compare>  // for operator<=>
+#include <cstdint>  // for int32_t
+#include <map>      // for map
+#include <vector>
 
 using namespace poike;
 
 namespace vkm {
 
-  class ComputePipeline : public GraphicsPipeline {
+  /**
+   * The compute pipelines only depend on the device, unlike GraphicsPipeline they have no swap chain nor render pass,
+   * so they can also be used without a window (see HeadlessSimulation).
+   */
+  class ComputePipeline : public NoCopy {
   public:
     ComputePipeline(const Device& device,
-                    const SwapChain& swapChain,
-                    const RenderPass& renderPass,
-                    const DescriptorSetLayout& descriptorSetLayout);
+                    const DescriptorSetLayout& descriptorSetLayout,
+                    const SimulationConfig& config,
+                    const PipelineCache& pipelineCache);
     ~ComputePipeline();
 
-    void recreate() final;
+    // Switch to the pipelines of the current configuration, compiled the first time it is used. The device must be
+    // idle, as the least recently used variant may be destroyed.
+    void recreate();
 
-    inline const VkPipeline& pipeline(int i) const { return m_pipelines[i]; }
+    inline const VkPipelineLayout& layout() const { return m_layout; }
+    // 0: clear grid, 1: particle to grid, 2: update grid, 3: grid to particle,
+    // then the initialisation ones, 4: particles in their box, 5: initial volume,
+    // 6: active blocks of the sparse grid, and the particle sort, 7: keys, 8: scan, 9: scatter, 10: gather,
+    // 11: indirect commands of the live particles, the particle removal, 12: mark, 13: holes, 14: fill, 15: emission
+    inline const VkPipeline& pipeline(int i) const { return (*m_pipelines)[i]; }
+    inline P2GMode p2gMode() const { return m_config.p2gMode; }
 
   private:
-    std::vector<VkPipeline> m_pipelines;
+    // Values of the specialization constants shared by every compute shader
+    struct SpecializationData {
+      int32_t gridResolution;
+      VkBool32 fixedPointGrid;  // the atomic P2G leaves fixed-point integers in the grid
+      VkBool32 sparseGrid;
+      int32_t poolBlocks;
+      int32_t sortKeys;
+      VkBool32 fusedGridUpdate;  // G2P reads the grid momentum, before the update grid pass
+      uint32_t workgroupSize;
+      float gravity;
+      int32_t gridWorkgroupSize;  // of the clear and update grid passes, which mark_blocks sizes on the sparse grid
+      int32_t p2gWorkgroupSize;   // of P2G and G2P, which particle_count sizes the indirect dispatches for
+      int32_t g2pWorkgroupSize;
+      VkBool32 outflow;  // the grid passes let the particles out through the edge the gravity pulls towards
+      int32_t instances;
+      int32_t instanceCapacity;  // particles of the buffers of each instance
 
-    void createPipeline() final;
-    void destroyComputePipeline();
+      auto operator<=>(const SpecializationData&) const = default;
+    };
+
+    // What the pipelines are compiled from: the shaders and the values of their specialization constants
+    struct Variant {
+      P2GMode p2gMode;
+      ParticleLayout layout;
+      SpecializationData constants;
+      StepWorkgroupSizes stepWorkgroupSizes;  // the workgroupSize constant of the passes of a step
+
+      auto operator<=>(const Variant&) const = default;
+    };
+
+    // Variants kept compiled, switching back to one of them doesn't recompile its shaders
+    static constexpr size_t maxVariants = 8;
+
+    VkPipelineLayout m_layout;
+    std::map<Variant, std::vector<VkPipeline>> m_variants;
+    std::vector<Variant> m_recentVariants;  // least recently used first
+    const std::vector<VkPipeline>* m_pipelines = nullptr;
+
+    const Device& m_device;
+    const DescriptorSetLayout& m_descriptorSetLayout;
+    const SimulationConfig& m_config;
+    const PipelineCache& m_pipelineCache;
+
+    Variant currentVariant() const;
+
+    std::vector<VkPipeline> createPipelines(const Variant& variant) const;
+    void destroyPipelines(const std::vector<VkPipeline>& pipelines) const;
+
+    VkShaderModule createShaderModule(const std::vector<unsigned char>& code) const;
   };
 }  // namespace vkm
 
-#endif  // COMPUTEPIPELINE_HPP
\ No newline at end of file
+#endif  // COMPUTEPIPELINE_HPP
@@ -0,0 +1,84 @@
+#ifndef COMPUTEUNIFORMBUFFER_HPP
+#define COMPUTEUNIFORMBUFFER_HPP
+
+#include <poike/poike.hpp>
+#include <struct/ComputeParticle.hpp>
+
+#include <algorithm>  // for min
+#include <cstdint>    // for uint32_t
+#include <cstring>    // for memcpy
+#include <deque>      // for deque
+#include <vector>
+
+using namespace poike;
+
+namespace vkm {
+
+  /**
+   * The compute passes read a single set of parameters per instance (see SimulationConfig::instances), so unlike
+   * UniformBuffers there is one copy per step in flight, not one per swap chain image, and it can be used without a
+   * window. The host only writes the copy of a step once the previous step which read it has completed.
+   */
+  class ComputeUniformBuffer : public NoCopy {
+  public:
+    ComputeUniformBuffer(const Device& device, uint32_t instances = 1, uint32_t copies = 1)
+        : m_device(device), m_instances(instances) {
+      for (uint32_t copy = 0; copy < copies; ++copy) {
+        Buffer<ComputeParticle>& buffer = m_buffers.emplace_back(
+            device, std::vector<ComputeParticle>(instances), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        // Mapped while it exists, so an update is a plain store in coherent memory
+        void* data;
+        vkMapMemory(m_device.logical(), buffer.memory(), 0, instances * sizeof(ComputeParticle), 0, &data);
+        m_data.push_back(static_cast<ComputeParticle*>(data));
+      }
+    }
+
+    ~ComputeUniformBuffer() {
+      for (Buffer<ComputeParticle>& buffer : m_buffers) {
+        vkUnmapMemory(m_device.logical(), buffer.memory());
+      }
+    }
+
+    // The same parameters for every instance, in the copy of the given step
+    void update(uint64_t step, const ComputeParticle& ubo) {
+      ComputeParticle* data = m_data[step % m_data.size()];
+      for (uint32_t i = 0; i < m_instances; ++i) {
+        memcpy(data + i, &ubo, sizeof(ubo));
+      }
+    }
+
+    // The parameters of each instance, in the copy of the given step
+    void update(uint64_t step, const std::vector<ComputeParticle>& ubos) {
+      memcpy(m_data[step % m_data.size()], ubos.data(),
+             std::min<size_t>(ubos.size(), m_instances) * sizeof(ComputeParticle));
+    }
+
+    // Every copy, while the device is idle
+    void updateAll(const ComputeParticle& ubo) {
+      for (size_t copy = 0; copy < m_data.size(); ++copy) update(copy, ubo);
+    }
+    void updateAll(const std::vector<ComputeParticle>& ubos) {
+      for (size_t copy = 0; copy < m_data.size(); ++copy) update(copy, ubos);
+    }
+
+    // The copy of step i is the buffer i modulo their number, and so is its descriptor set
+    inline std::vector<const IBuffer*> buffers() const {
+      std::vector<const IBuffer*> buffers;
+      for (const Buffer<ComputeParticle>& buffer : m_buffers) {
+        buffers.push_back(&buffer);
+      }
+      return buffers;
+    }
+
+  private:
+    const Device& m_device;
+    const uint32_t m_instances;
+    std::deque<Buffer<ComputeParticle>> m_buffers;
+    std::vector<ComputeParticle*> m_data;
+  };
+
+}  // namespace vkm
+
+#endif  // COMPUTEUNIFORMBUFFER_HPP
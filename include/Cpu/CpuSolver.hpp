@@ -0,0 +1,96 @@
+/**
+ * @file CpuSolver.hpp
+ * @brief Define CpuSolver class
+ *
+ * The whole MLS-MPM step (clear grid, P2G, grid update, G2P) on the CPU, spread across the cores by a ThreadPool.
+ * It needs no Vulkan device, and serves as a baseline for the GPU path.
+ *
+ * P2G scatters straight into the grid without atomics: the grid is cut into strips of stripWidth columns, and the
+ * particles are binned by strip at the start of each step. The stencil of a particle reaches one column out of its
+ * strip, so the strips of the same colour (even or odd) never write the same cell, and each colour runs in parallel.
+ */
+
+#pragma once
+
+#include <Cpu/SimdKernels.hpp>         // for SimdKernels, ParticleStreams, SimdLevel
+#include <Cpu/ThreadPool.hpp>          // for ThreadPool
+#include <ISolver.hpp>                 // for ISolver
+#include <SimulationConfig.hpp>        // for SimulationConfig
+#include <glm/glm.hpp>                 // for mat2, vec2
+#include <struct/Cell.hpp>             // for Cell
+#include <struct/ComputeParticle.hpp>  // for ComputeParticle
+#include <cstddef>                     // for size_t
+#include <cstdint>                     // for uint32_t
+#include <vector>                      // for vector
+
+namespace vkm {
+
+  // Same layout as Particle, without the vertex input descriptions (and so without poike)
+  struct alignas(16) CpuParticle {
+    alignas(16) glm::mat2 C;
+    alignas(8) glm::vec2 pos;
+    alignas(8) glm::vec2 vel;
+    alignas(4) float mass;
+    alignas(4) float volume_0;
+    alignas(8) glm::vec2 padding;
+  };
+
+  class CpuSolver : public ISolver {
+  public:
+    explicit CpuSolver(const SimulationConfig& config,
+                       size_t numThreads = std::thread::hardware_concurrency(),
+                       SimdLevel simdLevel = SimdLevel::Auto);
+
+    void run(uint32_t frames) final;
+
+    // Run a single simulation step
+    void step();
+
+    // The particles are reordered by strip each step, i is their current index
+    CpuParticle particle(size_t i) const;
+    glm::mat2 deformationGradient(size_t i) const;
+    inline const std::vector<Cell>& grid() const { return m_grid; }
+
+    inline const SimdKernels& kernels() const { return m_kernels; }
+    inline size_t numThreads() const { return m_pool.concurrency(); }
+
+  private:
+    // Number of particles or cells handed to a thread at once, a multiple of every SIMD width
+    static constexpr size_t grainSize = 1024;
+
+    // Columns of a strip of the grid, more than the one column the stencil reaches out of it
+    static constexpr uint32_t stripWidth = 4;
+
+    const SimulationConfig m_config;
+    ComputeParticle m_parameters;
+
+    const SimdKernels& m_kernels;
+    ThreadPool m_pool;
+
+    // Structure-of-arrays particles, ParticleStreams::count consecutive streams of numParticles floats, and the storage
+    // they are binned into, swapped with it after each binning
+    std::vector<float> m_storage, m_binnedStorage;
+    ParticleStreams m_particles, m_binnedParticles;
+
+    std::vector<Cell> m_grid;
+
+    // First particle of each strip after the binning, and one past the last
+    std::vector<size_t> m_stripBegin;
+    // Particles of each strip in each chunk of grainSize particles, then where the chunk moves its next one of the strip
+    std::vector<size_t> m_chunkStrips;
+
+    void initialize();
+
+    KernelParameters kernelParameters() const;
+
+    inline size_t numStrips() const { return (m_config.gridResolution + stripWidth - 1) / stripWidth; }
+
+    // Stable counting sort of the particles by strip
+    void binParticles();
+
+    void particleToGrid();
+    void updateGrid();
+    void gridToParticle();
+  };
+
+}  // namespace vkm
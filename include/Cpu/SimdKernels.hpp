@@ -0,0 +1,65 @@
+/**
+ * @file SimdKernels.hpp
+ * @brief Define the SIMD particle kernels of the CPU backend
+ *
+ * The per-particle halves of the step (P2G and G2P) work on a structure-of-arrays, a batch of particles per SIMD
+ * register. Each instruction set is compiled in its own translation unit, and the widest one supported by the
+ * running CPU is picked at startup.
+ */
+
+#pragma once
+
+#include <struct/Cell.hpp>  // for Cell
+#include <cstddef>          // for size_t
+#include <cstdint>          // for uint32_t
+
+namespace vkm {
+
+  enum class SimdLevel { Auto, Scalar, SSE, AVX2, AVX512 };
+
+  // One stream per component, matrices are column-major like glm (c01 is column 0, row 1)
+  struct ParticleStreams {
+    float *posX, *posY;
+    float *velX, *velY;
+    float *c00, *c01, *c10, *c11;  // affine momentum matrix
+    float *f00, *f01, *f10, *f11;  // deformation gradient
+    float *mass, *volume;
+
+    static constexpr size_t count = 14;
+  };
+
+  struct KernelParameters {
+    float dt;
+    float elastic_lambda;
+    float elastic_mu;
+    int gridResolution;
+  };
+
+  struct SimdKernels {
+    const char* name;
+
+    // Scatter the mass and momentum of [begin, end) to grid
+    void (*particleToGrid)(const ParticleStreams& particles,
+                           size_t begin,
+                           size_t end,
+                           const KernelParameters& parameters,
+                           Cell* grid);
+
+    // Gather the velocity of [begin, end) from grid, then advect the particles and update their deformation gradient
+    void (*gridToParticle)(const ParticleStreams& particles,
+                           size_t begin,
+                           size_t end,
+                           const KernelParameters& parameters,
+                           const Cell* grid);
+  };
+
+  // nullptr when the instruction set was not enabled at compile time
+  const SimdKernels* scalarKernels();
+  const SimdKernels* sseKernels();
+  const SimdKernels* avx2Kernels();
+  const SimdKernels* avx512Kernels();
+
+  // Widest kernels both compiled and supported by the CPU, no wider than level. Throw if level is not available.
+  const SimdKernels& selectSimdKernels(SimdLevel level = SimdLevel::Auto);
+
+}  // namespace vkm
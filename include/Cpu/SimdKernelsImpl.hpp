@@ -0,0 +1,300 @@
+/**
+ * @file SimdKernelsImpl.hpp
+ * @brief Define the MpmKernels template, shared by every SIMD translation unit
+ *
+ * Only include it from the src/Cpu/SimdKernels*.cpp files: V must wrap a register type with the static functions
+ * of ScalarVec below, and the file must be compiled with the matching instruction set. Everything is defined in an
+ * anonymous namespace, so that each file gets its own copy, built for its own instruction set: the linker must never
+ * pick the AVX copy of the scalar tail loops for the scalar path.
+ */
+
+#pragma once
+
+#include <Cpu/SimdKernels.hpp>  // for ParticleStreams, KernelParameters
+#include <struct/Cell.hpp>      // for Cell
+#include <cstddef>              // for size_t
+#include <cstdint>              // for int32_t, uint32_t
+#include <cstring>              // for memcpy
+
+namespace vkm {
+  namespace {
+
+    // One particle per "register", also used for the tail of every batched loop
+    struct ScalarVec {
+      using F = float;
+
+      static constexpr size_t width = 1;
+
+      static inline F load(const float* p) { return *p; }
+      static inline void store(float* p, F a) { *p = a; }
+      static inline F set(float a) { return a; }
+
+      static inline F add(F a, F b) { return a + b; }
+      static inline F sub(F a, F b) { return a - b; }
+      static inline F mul(F a, F b) { return a * b; }
+      static inline F div(F a, F b) { return a / b; }
+      static inline F min(F a, F b) { return a < b ? a : b; }
+      static inline F max(F a, F b) { return a > b ? a : b; }
+
+      // round toward zero, like the int conversion of the shaders
+      static inline F trunc(F a) { return static_cast<float>(static_cast<int32_t>(a)); }
+
+      // x = 2^exponent * mantissa, with mantissa in [1, 2)
+      static inline F exponent(F a) {
+        uint32_t bits;
+        std::memcpy(&bits, &a, sizeof(bits));
+        return static_cast<float>(static_cast<int32_t>((bits >> 23) & 0xff) - 127);
+      }
+      static inline F mantissa(F a) {
+        uint32_t bits;
+        std::memcpy(&bits, &a, sizeof(bits));
+        bits = (bits & 0x007fffff) | 0x3f800000;
+        std::memcpy(&a, &bits, sizeof(bits));
+        return a;
+      }
+
+      static inline F gather(const float* base, const int32_t* indices) { return base[indices[0]]; }
+    };
+
+    template <typename V> struct MpmKernels {
+      using F = typename V::F;
+
+      static constexpr size_t W = V::width;
+
+      // Floats between two Cell velocities in the grid array
+      static constexpr int32_t cellStride = sizeof(Cell) / sizeof(float);
+
+      // log(x) = e * ln(2) + log(m), with log(m) = 2 * atanh((m - 1) / (m + 1)) as an odd series, exact to a float
+      static inline F log(F x) {
+        const F one = V::set(1.0f);
+        const F m   = V::mantissa(x);
+        const F e   = V::exponent(x);
+        const F t   = V::div(V::sub(m, one), V::add(m, one));
+        const F t2  = V::mul(t, t);
+
+        F series = V::set(1.0f / 11.0f);
+        series   = V::add(V::mul(series, t2), V::set(1.0f / 9.0f));
+        series   = V::add(V::mul(series, t2), V::set(1.0f / 7.0f));
+        series   = V::add(V::mul(series, t2), V::set(1.0f / 5.0f));
+        series   = V::add(V::mul(series, t2), V::set(1.0f / 3.0f));
+        series   = V::add(V::mul(series, t2), one);
+
+        return V::add(V::mul(e, V::set(0.69314718f)), V::mul(V::mul(V::set(2.0f), t), series));
+      }
+
+      // quadratic interpolation weights along one axis, diff = (pos - cell) - 0.5
+      static inline void weights(F diff, F w[3]) {
+        const F half = V::set(0.5f);
+        const F a    = V::sub(half, diff);
+        const F b    = V::add(half, diff);
+        w[0]         = V::mul(half, V::mul(a, a));
+        w[1]         = V::sub(V::set(0.75f), V::mul(diff, diff));
+        w[2]         = V::mul(half, V::mul(b, b));
+      }
+
+      // first cell (bottom left) of the 3x3 stencil of each lane
+      static inline void stencilBase(F cellX, F cellY, int gridResolution, int32_t base[W]) {
+        alignas(64) float x[W], y[W];
+        V::store(x, cellX);
+        V::store(y, cellY);
+        for (size_t l = 0; l < W; ++l) {
+          base[l] = (static_cast<int32_t>(x[l]) - 1) * gridResolution + (static_cast<int32_t>(y[l]) - 1);
+        }
+      }
+
+      // P2G for the W particles starting at i, see particle_to_grid_atomic.comp
+      static inline void particleToGridBatch(const ParticleStreams& p,
+                                             size_t i,
+                                             const KernelParameters& k,
+                                             Cell* grid) {
+        const F f00 = V::load(p.f00 + i), f01 = V::load(p.f01 + i);
+        const F f10 = V::load(p.f10 + i), f11 = V::load(p.f11 + i);
+
+        const F J      = V::sub(V::mul(f00, f11), V::mul(f10, f01));
+        const F volume = V::mul(V::load(p.volume + i), J);
+        const F invJ   = V::div(V::set(1.0f), J);
+
+        // F_inv_T = inverse(transpose(F))
+        const F zero  = V::set(0.0f);
+        const F inv00 = V::mul(f11, invJ);
+        const F inv01 = V::sub(zero, V::mul(f10, invJ));
+        const F inv10 = V::sub(zero, V::mul(f01, invJ));
+        const F inv11 = V::mul(f00, invJ);
+
+        // Neo-Hookean P = mu * (F - F_inv_T) + lambda * log(J) * F_inv_T, MPM course equation 48
+        const F mu        = V::set(k.elastic_mu);
+        const F lambdaLog = V::mul(V::set(k.elastic_lambda), log(J));
+        const F P00       = V::add(V::mul(mu, V::sub(f00, inv00)), V::mul(lambdaLog, inv00));
+        const F P01       = V::add(V::mul(mu, V::sub(f01, inv01)), V::mul(lambdaLog, inv01));
+        const F P10       = V::add(V::mul(mu, V::sub(f10, inv10)), V::mul(lambdaLog, inv10));
+        const F P11       = V::add(V::mul(mu, V::sub(f11, inv11)), V::mul(lambdaLog, inv11));
+
+        // eq_16_term_0 = -volume * 4 * dt * (1 / J) * P * F_T
+        const F scale = V::mul(V::mul(V::set(-4.0f * k.dt), volume), invJ);
+        const F A00   = V::mul(scale, V::add(V::mul(P00, f00), V::mul(P10, f10)));
+        const F A01   = V::mul(scale, V::add(V::mul(P01, f00), V::mul(P11, f10)));
+        const F A10   = V::mul(scale, V::add(V::mul(P00, f01), V::mul(P10, f11)));
+        const F A11   = V::mul(scale, V::add(V::mul(P01, f01), V::mul(P11, f11)));
+
+        const F posX = V::load(p.posX + i), posY = V::load(p.posY + i);
+        const F cellX = V::trunc(posX), cellY = V::trunc(posY);
+        const F half  = V::set(0.5f);
+        const F diffX = V::sub(V::sub(posX, cellX), half);
+        const F diffY = V::sub(V::sub(posY, cellY), half);
+
+        F wx[3], wy[3];
+        weights(diffX, wx);
+        weights(diffY, wy);
+
+        const F mass = V::load(p.mass + i);
+        const F velX = V::load(p.velX + i), velY = V::load(p.velY + i);
+        const F c00 = V::load(p.c00 + i), c01 = V::load(p.c01 + i);
+        const F c10 = V::load(p.c10 + i), c11 = V::load(p.c11 + i);
+
+        // contributions of every lane to its 9 cells, scattered one lane at a time below since lanes may share cells
+        alignas(64) float cellMass[9][W], cellVelX[9][W], cellVelY[9][W];
+
+        for (int gx = 0; gx < 3; ++gx) {
+          for (int gy = 0; gy < 3; ++gy) {
+            const F weight = V::mul(wx[gx], wy[gy]);
+
+            // (cell_x - p.pos) + 0.5
+            const F distX = V::sub(V::set(static_cast<float>(gx - 1)), diffX);
+            const F distY = V::sub(V::set(static_cast<float>(gy - 1)), diffY);
+
+            const F weightedMass = V::mul(weight, mass);
+
+            // APIC P2G momentum contribution plus the fused force/momentum update from MLS-MPM
+            const F QX = V::add(V::mul(c00, distX), V::mul(c10, distY));
+            const F QY = V::add(V::mul(c01, distX), V::mul(c11, distY));
+            const F AX = V::add(V::mul(A00, distX), V::mul(A10, distY));
+            const F AY = V::add(V::mul(A01, distX), V::mul(A11, distY));
+
+            const int s = gx * 3 + gy;
+            V::store(cellMass[s], weightedMass);
+            V::store(cellVelX[s], V::add(V::mul(weightedMass, V::add(velX, QX)), V::mul(weight, AX)));
+            V::store(cellVelY[s], V::add(V::mul(weightedMass, V::add(velY, QY)), V::mul(weight, AY)));
+          }
+        }
+
+        alignas(64) int32_t base[W];
+        stencilBase(cellX, cellY, k.gridResolution, base);
+
+        for (size_t l = 0; l < W; ++l) {
+          for (int gx = 0; gx < 3; ++gx) {
+            for (int gy = 0; gy < 3; ++gy) {
+              const int s = gx * 3 + gy;
+              Cell& cell  = grid[base[l] + gx * k.gridResolution + gy];
+              cell.mass += cellMass[s][l];
+              cell.vel.x += cellVelX[s][l];
+              cell.vel.y += cellVelY[s][l];
+            }
+          }
+        }
+      }
+
+      // G2P for the W particles starting at i, see grid_to_particle.comp
+      static inline void gridToParticleBatch(const ParticleStreams& p,
+                                             size_t i,
+                                             const KernelParameters& k,
+                                             const Cell* grid) {
+        const F posX = V::load(p.posX + i), posY = V::load(p.posY + i);
+        const F cellX = V::trunc(posX), cellY = V::trunc(posY);
+        const F half  = V::set(0.5f);
+        const F diffX = V::sub(V::sub(posX, cellX), half);
+        const F diffY = V::sub(V::sub(posY, cellY), half);
+
+        F wx[3], wy[3];
+        weights(diffX, wx);
+        weights(diffY, wy);
+
+        alignas(64) int32_t base[W];
+        stencilBase(cellX, cellY, k.gridResolution, base);
+
+        const float* gridVelX = &grid[0].vel.x;
+        const float* gridVelY = &grid[0].vel.y;
+
+        F velX = V::set(0.0f), velY = V::set(0.0f);
+        F B00 = V::set(0.0f), B01 = V::set(0.0f), B10 = V::set(0.0f), B11 = V::set(0.0f);
+
+        for (int gx = 0; gx < 3; ++gx) {
+          for (int gy = 0; gy < 3; ++gy) {
+            const F weight = V::mul(wx[gx], wy[gy]);
+
+            alignas(64) int32_t offsets[W];
+            for (size_t l = 0; l < W; ++l) {
+              offsets[l] = (base[l] + gx * k.gridResolution + gy) * cellStride;
+            }
+
+            const F weightedVelX = V::mul(V::gather(gridVelX, offsets), weight);
+            const F weightedVelY = V::mul(V::gather(gridVelY, offsets), weight);
+
+            const F distX = V::sub(V::set(static_cast<float>(gx - 1)), diffX);
+            const F distY = V::sub(V::set(static_cast<float>(gy - 1)), diffY);
+
+            // APIC paper equation 10, B += mat2(weighted_velocity * dist.x, weighted_velocity * dist.y)
+            B00 = V::add(B00, V::mul(weightedVelX, distX));
+            B01 = V::add(B01, V::mul(weightedVelY, distX));
+            B10 = V::add(B10, V::mul(weightedVelX, distY));
+            B11 = V::add(B11, V::mul(weightedVelY, distY));
+
+            velX = V::add(velX, weightedVelX);
+            velY = V::add(velY, weightedVelY);
+          }
+        }
+
+        // C = B * (D^-1), with (D^-1) = 4 for quadratic weights
+        const F four = V::set(4.0f);
+        const F c00 = V::mul(B00, four), c01 = V::mul(B01, four);
+        const F c10 = V::mul(B10, four), c11 = V::mul(B11, four);
+
+        // advect particles, and clamp them into the simulation domain
+        const F dt   = V::set(k.dt);
+        const F low  = V::set(1.0f);
+        const F high = V::set(static_cast<float>(k.gridResolution - 2));
+        V::store(p.posX + i, V::min(V::max(V::add(posX, V::mul(velX, dt)), low), high));
+        V::store(p.posY + i, V::min(V::max(V::add(posY, V::mul(velY, dt)), low), high));
+
+        V::store(p.velX + i, velX);
+        V::store(p.velY + i, velY);
+        V::store(p.c00 + i, c00);
+        V::store(p.c01 + i, c01);
+        V::store(p.c10 + i, c10);
+        V::store(p.c11 + i, c11);
+
+        // F = (I + dt * C) * F
+        const F n00 = V::add(low, V::mul(dt, c00)), n01 = V::mul(dt, c01);
+        const F n10 = V::mul(dt, c10), n11 = V::add(low, V::mul(dt, c11));
+
+        const F f00 = V::load(p.f00 + i), f01 = V::load(p.f01 + i);
+        const F f10 = V::load(p.f10 + i), f11 = V::load(p.f11 + i);
+
+        V::store(p.f00 + i, V::add(V::mul(n00, f00), V::mul(n10, f01)));
+        V::store(p.f01 + i, V::add(V::mul(n01, f00), V::mul(n11, f01)));
+        V::store(p.f10 + i, V::add(V::mul(n00, f10), V::mul(n10, f11)));
+        V::store(p.f11 + i, V::add(V::mul(n01, f10), V::mul(n11, f11)));
+      }
+
+      static void particleToGrid(const ParticleStreams& p,
+                                 size_t begin,
+                                 size_t end,
+                                 const KernelParameters& k,
+                                 Cell* grid) {
+        size_t i = begin;
+        for (; i + W <= end; i += W) particleToGridBatch(p, i, k, grid);
+        for (; i < end; ++i) MpmKernels<ScalarVec>::particleToGridBatch(p, i, k, grid);
+      }
+
+      static void gridToParticle(const ParticleStreams& p,
+                                 size_t begin,
+                                 size_t end,
+                                 const KernelParameters& k,
+                                 const Cell* grid) {
+        size_t i = begin;
+        for (; i + W <= end; i += W) gridToParticleBatch(p, i, k, grid);
+        for (; i < end; ++i) MpmKernels<ScalarVec>::gridToParticleBatch(p, i, k, grid);
+      }
+    };
+
+  }  // namespace
+}  // namespace vkm
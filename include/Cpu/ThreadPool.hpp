@@ -0,0 +1,64 @@
+/**
+ * @file ThreadPool.hpp
+ * @brief Define ThreadPool class
+ *
+ * Work-stealing thread pool: each worker owns a task queue, pops from its front and steals from the back of the
+ * others when it runs dry.
+ */
+
+#pragma once
+
+#include <atomic>              // for atomic
+#include <condition_variable>  // for condition_variable
+#include <cstddef>             // for size_t
+#include <deque>               // for deque
+#include <functional>          // for function
+#include <memory>              // for unique_ptr
+#include <mutex>               // for mutex
+#include <thread>              // for thread
+#include <vector>              // for vector
+
+namespace vkm {
+
+  class ThreadPool {
+  public:
+    // Called with a [begin, end) chunk and the slot of the thread running it, in [0, concurrency())
+    using RangeTask = std::function<void(size_t begin, size_t end, size_t slot)>;
+
+    explicit ThreadPool(size_t numThreads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Workers plus the calling thread, which also runs tasks while it waits
+    inline size_t concurrency() const { return m_threads.size() + 1; }
+
+    // Split [0, count) into chunks of grain elements, run them on the pool and return once they are all done. The first
+    // exception thrown by a chunk is rethrown after that, the other chunks still run to completion
+    void parallelFor(size_t count, size_t grain, const RangeTask& task);
+
+  private:
+    // A queued task receives the slot of the thread which runs it
+    using Task = std::function<void(size_t slot)>;
+
+    struct Queue {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    void worker(size_t slot);
+    void push(size_t slot, Task task);
+    bool tryRun(size_t slot);
+
+    // One queue per worker, the last one belongs to the calling thread
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::atomic<size_t> m_pending;
+    std::atomic<bool> m_stop;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+  };
+
+}  // namespace vkm
@@ -0,0 +1,136 @@
+/**
+ * @file FrameExporter.hpp
+ * @brief Define FrameExporter class
+ *
+ * Stream the positions and velocities of the live particles to a file every few frames, for the offline analysis of
+ * their trajectories.
+ */
+
+#pragma once
+
+#include <poike/poike.hpp>
+#include <Compute/ComputeCommandBuffer.hpp>  // for ComputeCommandBuffer
+#include <SimulationConfig.hpp>              // for SimulationConfig
+#include <glm/glm.hpp>
+#include <atomic>              // for atomic
+#include <condition_variable>  // for condition_variable
+#include <cstdint>             // for uint32_t, uint64_t
+#include <deque>               // for deque
+#include <fstream>             // for ofstream
+#include <mutex>               // for mutex
+#include <string>              // for string
+#include <thread>              // for thread
+#include <vector>              // for vector
+
+using namespace poike;
+
+namespace vkm {
+
+  enum class FrameEncoding : uint32_t {
+    Float,      // positions and velocities as floats
+    Quantized,  // positions as uint16 over the grid, velocities as int16 over the velocity scale of their chunk
+  };
+
+  // Start of a frame file, followed by a chunk per exported frame, in the byte order of the host
+  struct FrameFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t encoding;  // FrameEncoding of every chunk
+    uint32_t gridResolution;
+    uint32_t interval;   // frames between two chunks
+    uint32_t instances;  // simulations of each chunk, which split its particles in equal parts
+    uint32_t padding;
+  };
+
+  // Start of a chunk, followed by the positions then the velocities of its particles, in their order in the buffers
+  struct FrameChunkHeader {
+    uint64_t frame;  // frames run before it, the frames dropped leave a gap
+    uint32_t count;
+    float velocityScale;  // largest velocity component of the chunk, with FrameEncoding::Quantized
+  };
+
+  class FrameExporter : public NoCopy {
+  public:
+    static constexpr char magic[8] = {'v', 'k', 'M', 'p', 'm', 'F', 'r', 'm'};
+    static constexpr uint32_t version = 2;
+
+    // Frames copied but not written yet at most, the next ones are dropped until one of them is written
+    static constexpr size_t ringSize = 3;
+
+    // Opens the file and writes its header, throws if it can't
+    FrameExporter(const Device& device,
+                  const CommandPool& commandPool,
+                  const ComputeCommandBuffer& commandBuffer,
+                  const SimulationConfig& config,
+                  const std::string& filename,
+                  uint32_t interval,
+                  FrameEncoding encoding);
+    // Writes the frames copied so far, then closes the file
+    ~FrameExporter();
+
+    // On a multiple of the interval, copy the particles into the next buffer of the ring, on the compute queue after
+    // the steps submitted so far, for the writer thread. Never waits: while that buffer is still written, the frame
+    // is dropped.
+    void capture(uint64_t frame);
+
+    // Whether frames captured are still to be written
+    bool writing() const;
+
+    // Block until every frame captured so far is written
+    void flush();
+
+    inline uint32_t interval() const { return m_interval; }
+    inline uint64_t written() const { return m_written; }
+    inline uint64_t dropped() const { return m_dropped; }
+    // Whether a chunk couldn't be written, the file is then truncated
+    inline bool failed() const { return m_failed; }
+
+  private:
+    // A buffer of the ring, mapped while it exists, with its copy recorded once
+    struct Slot : public NoCopy {
+      Slot(const Device& device, VkDeviceSize size);
+
+      StorageBuffer buffer;
+      const char* data         = nullptr;
+      VkCommandBuffer command  = VK_NULL_HANDLE;
+      VkFence fence            = VK_NULL_HANDLE;
+      uint64_t frame           = 0;
+      std::atomic<bool> queued = false;  // from its capture until its chunk is written
+    };
+
+    const Device& m_device;
+    const CommandPool& m_commandPool;
+    const SimulationConfig& m_config;
+    const uint32_t m_interval;
+    const FrameEncoding m_encoding;
+
+    std::deque<Slot> m_slots;
+    size_t m_next = 0;
+
+    std::ofstream m_file;
+    std::thread m_writer;
+
+    // The slots captured, in order, and whether the writer stops once they are written
+    std::mutex m_mutex;
+    std::condition_variable m_captured;
+    std::condition_variable m_chunkWritten;
+    std::deque<size_t> m_pending;
+    bool m_stopping = false;
+
+    std::atomic<uint64_t> m_written = 0;
+    uint64_t m_dropped              = 0;
+    std::atomic<bool> m_failed      = false;
+
+    // Positions and velocities gathered from the slot being written, only used by the writer thread
+    std::vector<glm::vec2> m_positions, m_velocities;
+    std::vector<uint16_t> m_quantizedPositions;
+    std::vector<int16_t> m_quantizedVelocities;
+
+    // Loop of the writer thread
+    void writeFrames();
+
+    // A chunk of the slot, once its copy is done. Returns false if it couldn't be written.
+    bool writeChunk(const Slot& slot);
+  };
+
+}  // namespace vkm
@@ -0,0 +1,98 @@
+/**
+ * @file FrameScheduler.hpp
+ * @brief Define FrameScheduler class
+ *
+ * Numbers the graphics frames and the compute steps, bounds how many of each are running on the device and lets the
+ * host wait for a given one. Also defines the semaphores between the compute and graphics submissions.
+ */
+
+#pragma once
+
+#include <poike/poike.hpp>
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint32_t, uint64_t
+#include <vector>   // for vector
+
+using namespace poike;
+
+namespace vkm {
+
+  // Binary semaphore from a submission of one queue to the next submission of the other. It is only waited once a
+  // submission signaled it, so the first submission of the other queue doesn't need a signaling one.
+  class QueueLink : public NoCopy {
+  public:
+    explicit QueueLink(const Device& device) : m_semaphore(device) {}
+
+    // Add the semaphore to the waits of a submission, if it was signaled
+    void wait(std::vector<VkSemaphore>& semaphores,
+              std::vector<VkPipelineStageFlags>& stages,
+              VkPipelineStageFlags stage) {
+      if (!m_signaled) return;
+      semaphores.push_back(m_semaphore.handle());
+      stages.push_back(stage);
+      m_signaled = false;
+    }
+
+    // Add the semaphore to the signals of a submission
+    void signal(std::vector<VkSemaphore>& semaphores) {
+      semaphores.push_back(m_semaphore.handle());
+      m_signaled = true;
+    }
+
+  private:
+    Semaphore m_semaphore;
+    bool m_signaled = false;
+  };
+
+  class FrameScheduler : public NoCopy {
+  public:
+    // A graphics frame is one submission of the graphics queue, a step one submission of the compute queue
+    FrameScheduler(const Device& device, uint32_t framesInFlight, uint32_t stepsInFlight)
+        : m_frames(device, framesInFlight), m_steps(device, stepsInFlight) {}
+
+    // Index of the next frame and of the next step
+    inline uint64_t frame() const { return m_frames.next; }
+    inline uint64_t step() const { return m_steps.next; }
+
+    // Block until the next frame may be submitted, framesInFlight - 1 frames at most are still running
+    inline void waitFrameSlot() { m_frames.waitSlot(); }
+    // Fence to submit with the next frame, whose index only moves on once it was submitted
+    inline VkFence frameFence() { return m_frames.fence(); }
+    inline void frameSubmitted() { m_frames.submitted(); }
+
+    // The same for the steps, the compute queue runs at most stepsInFlight steps ahead of the host
+    inline void waitStepSlot() { m_steps.waitSlot(); }
+    inline VkFence stepFence() { return m_steps.fence(); }
+    inline void stepSubmitted() { m_steps.submitted(); }
+
+    // Block until the given step has completed, before reading back what it wrote
+    inline void waitStep(uint64_t step) { m_steps.wait(step + 1); }
+
+  private:
+    // Submissions of one queue, each one signals the fence of its index modulo their number
+    class Timeline : public NoCopy {
+    public:
+      Timeline(const Device& device, uint32_t size);
+      ~Timeline();
+
+      void waitSlot();
+      // The fence of the next submission, reset. A failed submission leaves the index as it was, so that only the
+      // fences of actual submissions are ever waited.
+      VkFence fence();
+      void submitted();
+
+      // Block until the submissions before the given index have completed
+      void wait(uint64_t value);
+
+      uint64_t next      = 0;  // index of the next submission
+      uint64_t completed = 0;  // submissions known to be complete
+
+    private:
+      const Device& m_device;
+      std::vector<VkFence> m_fences;
+    };
+
+    Timeline m_frames, m_steps;
+  };
+
+}  // namespace vkm
@@ -0,0 +1,100 @@
+/**
+ * @file GpuProfiler.hpp
+ * @brief Define GpuProfiler class
+ *
+ * Timestamp queries around each compute pass and around the graphics command buffers, read back without stalling the
+ * GPU and kept as a rolling window of per-frame durations.
+ */
+
+#pragma once
+
+#include <poike/poike.hpp>
+#include <array>    // for array
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint32_t, uint64_t
+#include <deque>    // for deque
+#include <ostream>  // for ostream
+#include <vector>   // for vector
+
+using namespace poike;
+
+namespace vkm {
+
+  enum class GpuPass { ClearGrid, P2G, UpdateGrid, G2P, Graphics, Count };
+
+  class GpuProfiler : public NoCopy {
+  public:
+    // Durations of the last frames, in milliseconds
+    struct Stats {
+      double min, avg, p99;
+      size_t samples;
+    };
+
+    static constexpr size_t numPasses   = static_cast<size_t>(GpuPass::Count);
+    static constexpr size_t historySize = 1024;
+
+    GpuProfiler(const Device& device, uint32_t substeps, uint32_t numImages);
+    ~GpuProfiler();
+
+    // Resize the query pool, the command buffers which write the timestamps must be recorded again
+    void recreate(uint32_t substeps, uint32_t numImages);
+
+    // False when the queues can't write timestamps, every other call does nothing then
+    inline bool enabled() const { return m_queryPool != VK_NULL_HANDLE; }
+
+    // Swap chain images of the query pool
+    inline uint32_t numImages() const { return m_numImages; }
+
+    // Recording, the compute ones once per command buffer, just before the first step, and the pass ones after each
+    // dispatch
+    void beginCompute(VkCommandBuffer cmdBuffer) const;
+    void endComputePass(VkCommandBuffer cmdBuffer, uint32_t substep, GpuPass pass) const;
+    void beginGraphics(VkCommandBuffer cmdBuffer, uint32_t image) const;
+    void endGraphics(VkCommandBuffer cmdBuffer, uint32_t image) const;
+
+    // Read the timestamps of the last submission, if it has completed. Call them before submitting again.
+    void collectCompute();
+    void collectGraphics(uint32_t image);
+
+    Stats stats(GpuPass pass) const;
+    // Forget the samples of the rolling window, before measuring another configuration
+    void clearHistory();
+    static const char* name(GpuPass pass);
+
+    // Samples of the rolling window, one line per pass and frame
+    void writeCsv(std::ostream& os) const;
+    // Stats and samples of the rolling window
+    void writeJson(std::ostream& os) const;
+
+  private:
+    const Device& m_device;
+
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    uint32_t m_substeps;
+    uint32_t m_numImages;
+
+    // Nanoseconds per tick, and mask of the meaningful bits of a timestamp
+    double m_period;
+    uint64_t m_validMask;
+
+    std::array<std::deque<double>, numPasses> m_history;
+
+    // First timestamp of the last sampled submissions: the results of a submission that hasn't started yet are still
+    // those of the previous one, which must not be sampled twice
+    uint64_t m_lastCompute = 0;
+    std::vector<uint64_t> m_lastGraphics;
+
+    void createQueryPool();
+    void destroyQueryPool();
+
+    // Compute queries: start, then one per pass and substep. The graphics ones follow, two per image.
+    inline uint32_t numComputeQueries() const { return 1 + 4 * m_substeps; }
+    inline uint32_t computeQuery(uint32_t substep, GpuPass pass) const {
+      return 1 + 4 * substep + static_cast<uint32_t>(pass);
+    }
+    inline uint32_t graphicsQuery(uint32_t image) const { return numComputeQueries() + 2 * image; }
+
+    void push(GpuPass pass, double milliseconds);
+  };
+
+}  // namespace vkm
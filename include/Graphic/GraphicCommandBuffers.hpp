@@ -2,6 +2,7 @@
 #define GRAPHICCOMMANDBUFFERS_HPP
 
 #include <poike/poike.hpp>
+#include <GpuProfiler.hpp>
 #include <vector>  // for vector
 
 using namespace poike;
@@ -16,12 +17,21 @@ namespace vkm {
                           const GraphicsPipeline& graphicsPipeline,
                           const CommandPool& commandPool,
                           const DescriptorSets& descriptorSets,
-                          const std::vector<const IBuffer*>& buffers)
-        : CommandBuffers(device, renderPass, swapChain, graphicsPipeline, commandPool, descriptorSets, buffers) {
+                          const std::vector<const IBuffer*>& renderBuffers,
+                          const GpuProfiler* profiler = nullptr)
+        : CommandBuffers(device, renderPass, swapChain, graphicsPipeline, commandPool, descriptorSets, renderBuffers),
+          m_profiler(profiler) {
       createCommandBuffers();
     }
 
+    // The command buffer drawing the given render buffer (see ParticleRenderBuffers) to the given swap chain image
+    inline const VkCommandBuffer& command(size_t image, size_t renderBuffer) const {
+      return m_commandBuffers[image * m_buffers.size() + renderBuffer];
+    }
+
   private:
+    const GpuProfiler* m_profiler;  // optional, writes a timestamp around each command buffer
+
     void createCommandBuffers() final;
   };
 
@@ -3,6 +3,7 @@
 
 #include <vector>                     // for vector
 #include <poike/poike.hpp>
+#include <Graphic/GraphicUniformBuffers.hpp>  // for GraphicUniformBuffers
 
 using namespace poike;
 
@@ -15,17 +16,16 @@ namespace vkm {
                           const DescriptorSetLayout& descriptorSetLayout,
                           const DescriptorPool& descriptorPool,
                           const std::vector<const IBuffer*>& buffers,
-                          const std::vector<const IUniformBuffers*>& uniformBuffers)
-        : DescriptorSets(device,
-                         swapChain,
-                         descriptorSetLayout,
-                         descriptorPool,
-                         buffers,
-                         uniformBuffers) {
+                          const GraphicUniformBuffers& uniformBuffers)
+        : DescriptorSets(device, swapChain, descriptorSetLayout, descriptorPool, buffers, {}),
+          m_graphicUniformBuffers(uniformBuffers) {
       createDescriptorSets();
     }
 
   private:
+    // A buffer per swap chain image, so a descriptor set per image
+    const GraphicUniformBuffers& m_graphicUniformBuffers;
+
     void createDescriptorSets() final;
   };
 }  // namespace vkm
@@ -2,6 +2,8 @@
 #define GRAPHICGRAPHICSPIPELINE_HPP
 
 #include <poike/poike.hpp>
+#include <PipelineCache.hpp>
+#include <SimulationConfig.hpp>
 
 using namespace poike;
 
@@ -12,10 +14,17 @@ namespace vkm {
     GraphicGraphicsPipeline(const Device& device,
                             const SwapChain& swapChain,
                             const RenderPass& renderPass,
-                            const DescriptorSetLayout& descriptorSetLayout);
+                            const DescriptorSetLayout& descriptorSetLayout,
+                            const PipelineCache& pipelineCache,
+                            ParticleLayout particleLayout = ParticleLayout::AoS);
     ~GraphicGraphicsPipeline();
 
   private:
+    const PipelineCache& m_pipelineCache;
+
+    // The vertex buffer is either the Particle array or the position stream
+    const ParticleLayout m_particleLayout;
+
     void createPipeline() final;
   };
 }  // namespace vkm
@@ -0,0 +1,69 @@
+#ifndef GRAPHICUNIFORMBUFFERS_HPP
+#define GRAPHICUNIFORMBUFFERS_HPP
+
+#include <poike/poike.hpp>
+#include <struct/ParticleMVP.hpp>
+
+#include <cstdint>  // for uint32_t
+#include <cstring>  // for memcpy
+#include <deque>    // for deque
+#include <vector>   // for vector
+
+using namespace poike;
+
+namespace vkm {
+
+  /**
+   * One uniform buffer per swap chain image, like UniformBuffers, but mapped for as long as the buffers exist: from
+   * their creation to the swap chain recreation or the destructor. An update is a plain store in coherent memory.
+   */
+  class GraphicUniformBuffers : public NoCopy {
+  public:
+    GraphicUniformBuffers(const Device& device, const SwapChain& swapChain) : m_device(device), m_swapChain(swapChain) {
+      createUniformBuffers();
+    }
+
+    ~GraphicUniformBuffers() { destroyUniformBuffers(); }
+
+    // The number of buffers follows the number of swap chain images
+    void recreate() {
+      destroyUniformBuffers();
+      createUniformBuffers();
+    }
+
+    // The buffer of the given image, written once the frame which last used it has completed
+    void update(uint32_t currentImage, const ParticleMVP& ubo) { memcpy(m_data.at(currentImage), &ubo, sizeof(ubo)); }
+
+    inline VkDescriptorBufferInfo descriptor(size_t i) const { return m_buffers.at(i).descriptor(); }
+
+  private:
+    const Device& m_device;
+    const SwapChain& m_swapChain;
+
+    std::deque<Buffer<ParticleMVP>> m_buffers;
+    std::vector<void*> m_data;
+
+    void createUniformBuffers() {
+      for (size_t i = 0; i < m_swapChain.numImages(); ++i) {
+        Buffer<ParticleMVP>& buffer = m_buffers.emplace_back(
+            m_device, std::vector<ParticleMVP>(1), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        void* data;
+        vkMapMemory(m_device.logical(), buffer.memory(), 0, sizeof(ParticleMVP), 0, &data);
+        m_data.push_back(data);
+      }
+    }
+
+    void destroyUniformBuffers() {
+      for (Buffer<ParticleMVP>& buffer : m_buffers) {
+        vkUnmapMemory(m_device.logical(), buffer.memory());
+      }
+      m_data.clear();
+      m_buffers.clear();
+    }
+  };
+
+}  // namespace vkm
+
+#endif  // GRAPHICUNIFORMBUFFERS_HPP
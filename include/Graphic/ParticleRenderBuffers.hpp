@@ -0,0 +1,48 @@
+#ifndef PARTICLERENDERBUFFERS_HPP
+#define PARTICLERENDERBUFFERS_HPP
+
+#include <poike/poike.hpp>
+#include <struct/Particle.hpp>
+#include <SimulationConfig.hpp>
+#include <vector>  // for vector
+
+using namespace poike;
+
+namespace vkm {
+
+  // Copies of the particle buffer drawn by the graphics queue. Each compute submission writes one of them at its end,
+  // while the graphics queue draws the other one, so that rendering a frame overlaps the simulation of the next. They
+  // start with the indirect draw command of the live particles.
+  class ParticleRenderBuffers : public NoCopy {
+  public:
+    static constexpr size_t size = 2;
+
+    ParticleRenderBuffers(const Device& device, const SimulationConfig& config)
+        : front(device, bufferSize(config), usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+          back(device, bufferSize(config), usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {}
+
+    // Bytes before the vertices: a VkDrawIndirectCommand
+    static constexpr VkDeviceSize drawCommandSize = sizeof(VkDrawIndirectCommand);
+
+    // The draw command, then the same content as the particle storage buffer: the whole records, or the position
+    // stream with ParticleLayout::SoA
+    static inline VkDeviceSize bufferSize(const SimulationConfig& config) {
+      const VkDeviceSize vertexSize = config.layout == ParticleLayout::SoA ? sizeof(glm::vec2) : sizeof(Particle);
+      return drawCommandSize + config.particleCapacity() * vertexSize;
+    }
+
+    // The buffer written by the compute submission of the given frame
+    static inline size_t index(uint64_t frame) { return static_cast<size_t>(frame % size); }
+
+    std::vector<const IBuffer*> buffers() const { return {&front, &back}; }
+
+  private:
+    static constexpr VkBufferUsageFlags usage
+        = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    StorageBuffer front, back;
+  };
+
+}  // namespace vkm
+
+#endif  // PARTICLERENDERBUFFERS_HPP
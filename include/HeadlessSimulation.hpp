@@ -0,0 +1,123 @@
+/**
+ * @file HeadlessSimulation.hpp
+ * @brief Define HeadlessSimulation class
+ *
+ * Run the simulation without window, swap chain nor render pass: only a device and its compute queue.
+ */
+
+#pragma once
+
+#include <poike/poike.hpp>
+#include <Checkpoint.hpp>                       // for Checkpoint
+#include <Compute/ComputeCommandBuffer.hpp>     // for ComputeCommandBuffer
+#include <Compute/ComputeDescriptorSets.hpp>    // for ComputeDescriptorSets
+#include <Compute/ComputePipeline.hpp>          // for ComputePipeline
+#include <Compute/ComputeUniformBuffer.hpp>     // for ComputeUniformBuffer
+#include <Compute/MPMStorageBuffer.hpp>         // for MPMStorageBuffer
+#include <FrameExporter.hpp>                    // for FrameExporter
+#include <GpuProfiler.hpp>                      // for GpuProfiler
+#include <ISolver.hpp>                          // for ISolver
+#include <PipelineCache.hpp>                    // for PipelineCache
+#include <SimulationConfig.hpp>                 // for SimulationConfig
+#include <struct/ComputeParticle.hpp>           // for ComputeParticle
+#include <array>                                // for array
+#include <optional>                             // for optional
+#include <string>                               // for string
+#include <vector>                               // for vector
+
+using namespace poike;
+
+namespace vkm {
+  class HeadlessSimulation : public ISolver, public NoCopy {
+  public:
+    HeadlessSimulation(const std::string& appName,
+                       const DebugOption& debugOption,
+                       const SimulationConfig& config,
+                       const std::string& pipelineCacheFile = "");
+    ~HeadlessSimulation();
+
+    void run(uint32_t frames) final;
+
+    // Sample the timestamps of every batch, each one is then waited before the next is submitted
+    inline void setProfiling(bool profiling) { m_profiling = profiling; }
+    inline const GpuProfiler& profiler() const { return m_profiler; }
+
+    // Rebuild the pipelines and command buffers with other workgroup sizes for the passes of a step, and restart the
+    // simulation from its initial particles
+    void setWorkgroupSizes(const StepWorkgroupSizes& sizes);
+
+    // Time each pass of a step with every candidate workgroup size the device supports, and switch to the fastest
+    // one of each. Without timestamp queries the sizes are left unchanged.
+    StepWorkgroupSizes tuneWorkgroupSizes();
+
+    // Switch to the workgroup sizes stored for this device in the file (see WorkgroupTuning), tuned and added to it
+    // first if there are none yet. Returns them.
+    StepWorkgroupSizes useTunedWorkgroupSizes(const std::string& filename);
+
+    // Parameters of an instance of the simulation (see SimulationConfig::instances), used from the next run(). They
+    // all start with the time step of the configuration and the elastic parameters.
+    void setParameters(uint32_t instance, const ComputeParticle& parameters);
+
+    // Save the state to the file every interval frames of run(), and at its end. With an interval of 0, only at the
+    // end. Throws with several instances, the checkpoints hold a single one.
+    void setCheckpoint(const std::string& filename, uint32_t interval);
+    inline const Checkpoint& checkpoint() const { return m_checkpoint; }
+
+    // Continue from the state of a checkpoint file, with its parameters. Throws if it can't be loaded, or with several
+    // instances.
+    void restore(const std::string& filename);
+
+    // Stream the particles to the file every interval frames of run(), see FrameExporter. Throws if it can't be opened.
+    void setExport(const std::string& filename, uint32_t interval, FrameEncoding encoding);
+    inline const std::optional<FrameExporter>& exporter() const { return m_exporter; }
+
+  private:
+    // Number of frames chained in a single queue submission
+    static constexpr uint32_t framesPerSubmit = 64;
+
+    // Workgroup sizes tried by the tuner, and the frames it runs with each one: the timestamps are only read for the
+    // last frame of a submission
+    static constexpr uint32_t tuningCandidates[] = {32, 64, 128, 256, 512, 1024};
+    static constexpr uint32_t tuningFrames       = 8 * framesPerSubmit;
+
+    SimulationConfig m_config;
+    std::vector<ComputeParticle> m_parameters;  // of each instance
+
+    Instance instance;
+    Device device;
+
+    CommandPool commandPool, commandPoolCompute;
+    PipelineCache pipelineCache;
+
+    // Descriptor Pool
+    const std::vector<VkDescriptorPoolSize> psCompute;
+    VkDescriptorPoolCreateInfo dpiCompute;
+    DescriptorPool dpCompute;
+
+    // Buffers
+    MPMStorageBuffer storageBuffer;
+    ComputeUniformBuffer uniformBufferCompute;
+    std::vector<const IBuffer*> vecSBCompute;
+
+    // Compute
+    DescriptorSetLayout dslCompute;
+    ComputeDescriptorSets dsCompute;
+    ComputePipeline gpCompute;
+    GpuProfiler m_profiler;
+    ComputeCommandBuffer cbCompute;
+    Checkpoint m_checkpoint;
+    std::optional<FrameExporter> m_exporter;
+
+    // Two batches in flight, so the queue never waits for the CPU to submit the next one
+    std::array<VkFence, 2> m_fences;
+
+    bool m_profiling = false;
+
+    // Frames run so far, to sort the particles every sortInterval of them
+    uint64_t m_frames = 0;
+
+    std::string m_checkpointFile;
+    uint32_t m_checkpointInterval = 0;
+  };
+
+}  // namespace vkm
@@ -0,0 +1,25 @@
+/**
+ * @file ISolver.hpp
+ * @brief Define ISolver interface
+ *
+ * A simulation backend, which can run without window: the GPU one (HeadlessSimulation) or the CPU one (CpuSolver).
+ */
+
+#ifndef ISOLVER_HPP
+#define ISOLVER_HPP
+
+#include <cstdint>  // for uint32_t
+
+namespace vkm {
+
+  class ISolver {
+  public:
+    virtual ~ISolver() = default;
+
+    // Run the given number of frames (each one made of config.substeps steps) and wait for them to finish
+    virtual void run(uint32_t frames) = 0;
+  };
+
+}  // namespace vkm
+
+#endif  // ISOLVER_HPP
@@ -8,19 +8,30 @@
 #pragma once
 
 #include <poike/poike.hpp>
+#include <Checkpoint.hpp>                                // for Checkpoint
 #include <struct/ComputeParticle.hpp>             // for ComputeParticle
 #include <struct/ParticleMVP.hpp>                 // for ParticleMVP
 #include <struct/Particle.hpp>                    // for Particle
 #include <cstdlib>                                       // for size_t
+#include <deque>                                         // for deque
 #include <functional>                                    // for function
 #include <Compute/ComputeCommandBuffer.hpp>     // for ComputeComma...
 #include <Compute/MPMStorageBuffer.hpp>
 #include <Compute/ComputeDescriptorSets.hpp>    // for ComputeDescr...
 #include <Compute/ComputePipeline.hpp>          // for ComputePipeline
+#include <Compute/ComputeUniformBuffer.hpp>     // for ComputeUniformBuffer
 #include <Graphic/GraphicCommandBuffers.hpp>    // for GraphicComma...
 #include <Graphic/GraphicDescriptorSets.hpp>    // for GraphicDescr...
 #include <Graphic/GraphicGraphicsPipeline.hpp>  // for GraphicGraph...
 #include <Graphic/GraphicRenderPass.hpp>              // for GraphicRenderPass
+#include <Graphic/GraphicUniformBuffers.hpp>    // for GraphicUniformBuffers
+#include <Graphic/ParticleRenderBuffers.hpp>    // for ParticleRenderBuffers
+#include <FrameExporter.hpp>                             // for FrameExporter
+#include <FrameScheduler.hpp>                            // for FrameScheduler
+#include <GpuProfiler.hpp>                               // for GpuProfiler
+#include <PipelineCache.hpp>                             // for PipelineCache
+#include <SimulationConfig.hpp>                          // for SimulationConfig
+#include <optional>                                      // for optional
 #include <string>                                        // for string
 #include <vector>                                        // for vector
 
@@ -34,15 +45,44 @@ namespace vkm {
         android_app* androidApp,
 #endif
         const std::string& appName,
-        const DebugOption& debugOption);
+        const DebugOption& debugOption,
+        const SimulationConfig& config = SimulationConfig(),
+        const std::string& pipelineCacheFile = "");
 
     void run();
 
+    inline const GpuProfiler& profiler() const { return m_profiler; }
+
+    // Rebuild the compute pipelines and command buffers with other workgroup sizes for the passes of a step, the
+    // particles are kept
+    void setWorkgroupSizes(const StepWorkgroupSizes& sizes);
+
+    // Switch to the workgroup sizes stored for this device in the file (see WorkgroupTuning). Returns false, without
+    // changing them, when there are none yet: they are then to be tuned, see HeadlessSimulation::tuneWorkgroupSizes.
+    bool useStoredWorkgroupSizes(const std::string& filename);
+
+    // Save the state to the file every interval steps while playing, and when the window is closed. With an interval
+    // of 0, only then. The window also gets buttons to save and load it.
+    void setCheckpoint(const std::string& filename, uint32_t interval);
+    inline const Checkpoint& checkpoint() const { return m_checkpoint; }
+
+    // Continue from the state of a checkpoint file, with its parameters. Throws if it can't be loaded.
+    void restore(const std::string& filename);
+
+    // Stream the particles to the file every interval steps while playing, see FrameExporter. Throws if it can't be
+    // opened.
+    void setExport(const std::string& filename, uint32_t interval, FrameEncoding encoding);
+    inline const std::optional<FrameExporter>& exporter() const { return m_exporter; }
+
 #ifdef __ANDROID__
     void togglePause() const;
 #endif
 
   private:
+    SimulationConfig m_config;
+
+    PipelineCache pipelineCache;
+
     CommandPool commandPool, commandPoolCompute;
 
     // Descriptor Pool
@@ -55,14 +95,14 @@ namespace vkm {
     DescriptorPool dpCompute;
 
     // Buffers
-    UniformBuffers<ParticleMVP> uniformBuffersGraphic;
+    GraphicUniformBuffers uniformBuffersGraphic;
     MPMStorageBuffer storageBuffer;
-    UniformBuffers<ComputeParticle> uniformBuffersCompute;
+    ComputeUniformBuffer uniformBufferCompute;
+    ParticleRenderBuffers renderBuffers;
 
     // Vector Buffer
-    std::vector<const IUniformBuffers*> vecUBGraphic;
-    std::vector<const IUniformBuffers*> vecUBCompute;
     std::vector<const IBuffer*> vecSBCompute;
+    std::vector<const IBuffer*> vecRenderBuffers;
 
     // Graphic
     GraphicRenderPass rpGraphic;
@@ -70,17 +110,29 @@ namespace vkm {
     DescriptorSetLayout dslGraphic;
     GraphicGraphicsPipeline gpGraphic;
     GraphicDescriptorSets dsGraphic;
-    Semaphore semaphoreGraphic;
+    std::deque<QueueLink> graphicsLinks;  // signaled when a render buffer was drawn
 
     // Compute
 
     DescriptorSetLayout dslCompute;
     ComputeDescriptorSets dsCompute;
     ComputePipeline gpCompute;
-    Semaphore semaphoreCompute;
+    std::deque<QueueLink> computeLinks;  // signaled when a render buffer was written
+
+    // Timestamps written by both command buffers
+    GpuProfiler m_profiler;
 
     ComputeCommandBuffer cbCompute;
     GraphicCommandBuffers cbGraphic;
+    Checkpoint m_checkpoint;
+    std::optional<FrameExporter> m_exporter;
+
+    // Numbers the frames and the compute steps, to sort the particles every sortInterval steps and alternate the
+    // render buffers
+    FrameScheduler m_scheduler;
+
+    std::string m_checkpointFile;
+    uint32_t m_checkpointInterval = 0;
 
 #ifndef __ANDROID__
     ImGuiApp interface;
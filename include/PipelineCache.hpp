@@ -0,0 +1,52 @@
+/**
+ * @file PipelineCache.hpp
+ * @brief Define PipelineCache class
+ *
+ * VkPipelineCache shared by every pipeline, loaded from a file at startup and written back at exit, so that the
+ * shaders are only compiled by the driver on the first run.
+ */
+
+#pragma once
+
+#include <poike/poike.hpp>
+#include <cstdint>  // for uint32_t
+#include <string>   // for string
+#include <vector>   // for vector
+
+using namespace poike;
+
+namespace vkm {
+
+  class PipelineCache : public NoCopy {
+  public:
+    // Without file, the cache only lives as long as the application
+    PipelineCache(const Device& device, const std::string& filename = "");
+    ~PipelineCache();
+
+    inline const VkPipelineCache& handle() const { return m_cache; }
+
+    // Write the cache to its file, done at destruction. Returns false if it couldn't be written.
+    bool save() const;
+
+  private:
+    // Written before the cache data: a file from another device or driver is ignored
+    struct FileHeader {
+      uint32_t magic;
+      uint32_t vendorID;
+      uint32_t deviceID;
+      uint32_t driverVersion;
+      uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+
+    static constexpr uint32_t fileMagic = 0x4D504D76;  // "vMPM"
+
+    VkPipelineCache m_cache = VK_NULL_HANDLE;
+    FileHeader m_header;
+
+    const Device& m_device;
+    const std::string m_filename;
+
+    std::vector<char> load() const;
+  };
+
+}  // namespace vkm
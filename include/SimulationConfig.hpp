@@ -0,0 +1,211 @@
+/**
+ * @file SimulationConfig.hpp
+ * @brief Define SimulationConfig struct
+ *
+ * Sizes of the simulation, chosen at startup and shared by the buffers, the command buffers and the shaders.
+ */
+
+#ifndef SIMULATIONCONFIG_HPP
+#define SIMULATIONCONFIG_HPP
+
+#include <algorithm>  // for min
+#include <array>      // for array
+#include <cmath>      // for abs, ceil, sqrt
+#include <cstdint>    // for uint32_t
+#include <stdexcept>  // for runtime_error
+#include <vector>     // for vector
+#include <struct/Emitter.hpp>
+
+namespace vkm {
+
+  // How the particle to grid pass accumulates into the grid
+  enum class P2GMode {
+    Serial,  // a single invocation walks every particle
+    Atomic,  // one invocation per particle, fixed-point atomic accumulation
+    Tiled,   // like Atomic, but each workgroup first accumulates in a tile of shared memory
+  };
+
+  // How the particles are stored on the GPU
+  enum class ParticleLayout {
+    AoS,  // one buffer of Particle, next to the deformation gradients
+    SoA,  // one buffer per member, the vertex buffer only holds the positions
+  };
+
+  // How the grid is stored on the GPU
+  enum class GridMode {
+    Dense,   // every cell of the domain
+    Sparse,  // a pool of blocks of cells, given each step to the blocks around the particles
+  };
+
+  // Compute passes of a simulation step, in their order (the same as GpuPass)
+  enum class StepPass { ClearGrid, P2G, UpdateGrid, G2P, Count };
+
+  // Workgroup size of each pass of a step, 0 for the default one
+  using StepWorkgroupSizes = std::array<uint32_t, static_cast<size_t>(StepPass::Count)>;
+
+  struct SimulationConfig {
+    uint32_t numParticles   = 4096;
+    uint32_t gridResolution = 64;
+    P2GMode p2gMode         = P2GMode::Atomic;
+    ParticleLayout layout   = ParticleLayout::AoS;
+    GridMode gridMode       = GridMode::Dense;
+
+    // Capacity of the sparse grid pool in blocks, 0 to have room for every block of the domain. The cells of the
+    // blocks which don't fit are left out of the step.
+    uint32_t poolBlocks = 0;
+
+    // Simulation steps recorded in one compute submission (one rendered frame), each one advancing by dt
+    uint32_t substeps = 1;
+    float dt          = 0.1f;
+
+    // Frames between two sorts of the particles by cell, which keeps the neighbouring invocations on neighbouring
+    // cells as the material mixes, 0 to never sort them
+    uint32_t sortInterval = 0;
+
+    // Clear the dense grid with a buffer fill, and convert the grid momentum to velocity in G2P instead of a separate
+    // update grid pass: two dispatches and a barrier less per step, for the small grids
+    bool fuseGridPasses = false;
+
+    // Invocations per workgroup of the particle and cell passes, compiled into the shaders: the best one depends on the
+    // device. The dispatches round the invocations up to whole workgroups.
+    uint32_t workgroupSize = 256;
+
+    // Workgroup sizes of the passes of a step measured the fastest on the device (see
+    // HeadlessSimulation::tuneWorkgroupSizes), 0 to use workgroupSize
+    StepWorkgroupSizes stepWorkgroupSizes = {};
+
+    // Acceleration of the particles along y, in cells per time unit squared, compiled into the shaders
+    float gravity = 0.3f;
+
+    // Particles which fit in the buffers, 0 for numParticles. The emitters add particles up to it.
+    uint32_t capacity = 0;
+
+    // Sources of particles, emitting on the device each frame while the simulation runs
+    std::vector<Emitter> emitters;
+
+    // Let the particles out through the edge of the domain the gravity pulls towards, instead of sliding along it. They
+    // are removed from the buffers at the start of the next frame.
+    bool outflow = false;
+
+    // Independent simulations run by the same dispatches, each one in its own part of the buffers and with its own
+    // parameters (see instance.glsl), to fill the device with small simulations. Only on a dense grid, without tiled
+    // P2G, sort, emitters nor outflow.
+    uint32_t instances = 1;
+
+    // Emitters which fit in one buffer update (see ComputeCommandBuffer::initialise)
+    static constexpr uint32_t maxEmitters = 64;
+
+    // Instances whose parameters fit in the uniform buffer range every device supports
+    static constexpr uint32_t maxInstances = 1024;
+
+    // Spacing between two particles of the initial box, in cells
+    static constexpr float particleSpacing = 0.5f;
+
+    // Largest mass or momentum a contribution of a particle to a cell may have, same as FIXED_POINT_RANGE in the P2G
+    // shaders: the cells sum them as int32 with 16 fractional bits
+    static constexpr float fixedPointRange = 32767.0f;
+
+    // Cells on one side of a block of the sparse grid, same as BLOCK_SIDE in sparse_grid.glsl
+    static constexpr uint32_t blockSide = 8;
+
+    inline uint32_t numCells() const { return gridResolution * gridResolution; }
+
+    // Blocks of the domain, and those which have room in the sparse grid pool
+    inline uint32_t numBlocks() const { return numCells() / (blockSide * blockSide); }
+    inline uint32_t numPoolBlocks() const { return poolBlocks > 0 ? std::min(poolBlocks, numBlocks()) : numBlocks(); }
+
+    // Keys of the particle sort, the Morton codes of the cells: the grid resolution rounded up to a power of two, squared
+    inline uint32_t numSortKeys() const {
+      uint32_t side = 1;
+      while (side < gridResolution) side *= 2;
+      return side * side;
+    }
+
+    // Cells stored in the grid buffer, the grids of the instances one after the other
+    inline uint32_t numGridCells() const {
+      return gridMode == GridMode::Sparse ? numPoolBlocks() * blockSide * blockSide : numCells() * instances;
+    }
+
+    // Workgroup size of a pass of the step. The passes over the sparse grid share the clear grid one, the active blocks
+    // counting their indirect dispatch in these workgroups (see mark_blocks.comp).
+    inline uint32_t passWorkgroupSize(StepPass pass) const {
+      if (gridMode == GridMode::Sparse && pass == StepPass::UpdateGrid) pass = StepPass::ClearGrid;
+      const uint32_t size = stepWorkgroupSizes[static_cast<size_t>(pass)];
+      return size > 0 ? size : workgroupSize;
+    }
+
+    // Workgroups of a dispatch of the pass with one invocation per particle or cell
+    inline uint32_t numGroups(uint32_t invocations, StepPass pass) const {
+      return (invocations + passWorkgroupSize(pass) - 1) / passWorkgroupSize(pass);
+    }
+
+    // Particles of the buffers of each instance, the initial ones and those added by the emitters
+    inline uint32_t instanceCapacity() const { return capacity > 0 ? capacity : numParticles; }
+
+    // Particles the buffers are sized for, those of every instance
+    inline uint32_t particleCapacity() const { return instanceCapacity() * instances; }
+
+    // Particles added each frame by the emitters, as long as they fit
+    inline uint32_t emissionRate() const {
+      uint32_t rate = 0;
+      for (const Emitter& emitter : emitters) rate += emitter.rate;
+      return rate;
+    }
+
+    // Number of particles on one side of the initial square box
+    inline uint32_t boxSide() const { return static_cast<uint32_t>(std::ceil(std::sqrt(float(numParticles)))); }
+
+    void validate() const {
+      if (numParticles == 0 && emitters.empty()) {
+        throw std::runtime_error("the simulation needs at least one particle or one emitter!");
+      }
+
+      if (capacity > 0 && capacity < numParticles) {
+        throw std::runtime_error("the capacity is smaller than the number of particles!");
+      }
+
+      if (emitters.size() > maxEmitters) {
+        throw std::runtime_error("too many emitters!");
+      }
+
+      // the momentum of an emitted particle, of mass 1, must fit in the fixed-point cells
+      for (const Emitter& emitter : emitters) {
+        if (std::abs(emitter.velocity.x) >= fixedPointRange || std::abs(emitter.velocity.y) >= fixedPointRange) {
+          throw std::runtime_error("the velocity of an emitter exceeds the fixed-point range of the grid!");
+        }
+      }
+
+      if (substeps == 0 || dt <= 0.0f) {
+        throw std::runtime_error("the simulation needs at least one substep and a positive time step!");
+      }
+
+      if (instances == 0 || instances > maxInstances) {
+        throw std::runtime_error("the number of instances is out of range!");
+      }
+
+      // the particles of the instances follow each other, and each pass covers all of them
+      if (instances > 1
+          && (gridMode == GridMode::Sparse || p2gMode == P2GMode::Tiled || sortInterval > 0 || !emitters.empty()
+              || outflow || instanceCapacity() != numParticles)) {
+        throw std::runtime_error(
+            "the instances only run on a dense grid, without tiled P2G, sort, emitters, outflow nor extra capacity!");
+      }
+
+      if (workgroupSize == 0) {
+        throw std::runtime_error("the workgroups need at least one invocation!");
+      }
+
+      if (gridMode == GridMode::Sparse && gridResolution % blockSide != 0) {
+        throw std::runtime_error("the sparse grid resolution must be a multiple of the block side!");
+      }
+
+      // Keep a margin for the boundary conditions (2 cells) and the 3x3 stencil
+      if (boxSide() * particleSpacing + 8 > gridResolution) {
+        throw std::runtime_error("the grid resolution is too small for this number of particles!");
+      }
+    }
+  };
+
+}  // namespace vkm
+
+#endif  // SIMULATIONCONFIG_HPP
@@ -0,0 +1,52 @@
+/**
+ * @file WorkgroupTuning.hpp
+ * @brief Define WorkgroupTuning class
+ *
+ * Workgroup sizes of the passes of a step measured the fastest on each device (see
+ * HeadlessSimulation::useTunedWorkgroupSizes), kept in a text file next to the pipeline cache.
+ */
+
+#pragma once
+
+#include <poike/poike.hpp>
+#include <SimulationConfig.hpp>  // for SimulationConfig, StepWorkgroupSizes
+#include <map>                   // for map
+#include <optional>              // for optional
+#include <string>                // for string
+
+using namespace poike;
+
+namespace vkm {
+
+  class WorkgroupTuning {
+  public:
+    // Load the sizes of the file, if it exists
+    explicit WorkgroupTuning(const std::string& filename);
+
+    // File of the tuned sizes kept next to a pipeline cache file
+    static std::string filename(const std::string& pipelineCacheFile);
+
+    // Sizes tuned on the device and driver for the shaders of the configuration, if any
+    std::optional<StepWorkgroupSizes> find(const Device& device, const SimulationConfig& config) const;
+    void store(const Device& device, const SimulationConfig& config, const StepWorkgroupSizes& sizes);
+
+    // Same, from the properties of the device
+    std::optional<StepWorkgroupSizes> find(const VkPhysicalDeviceProperties& properties,
+                                           const SimulationConfig& config) const;
+    void store(const VkPhysicalDeviceProperties& properties,
+               const SimulationConfig& config,
+               const StepWorkgroupSizes& sizes);
+
+    // Write every entry to the file. Returns false if it couldn't be written.
+    bool save() const;
+
+  private:
+    const std::string m_filename;
+
+    // One line of the file per key: the device, its driver and the shaders, then the size of each pass of a step
+    std::map<std::string, StepWorkgroupSizes> m_entries;
+
+    static std::string key(const VkPhysicalDeviceProperties& properties, const SimulationConfig& config);
+  };
+
+}  // namespace vkm
@@ -1,11 +1,14 @@
 #ifndef COMPUTE_PARTICLE_HPP
 #define COMPUTE_PARTICLE_HPP
 
+// Default material, the values can be changed at runtime
+#define ELASTIC_LAMBDA 10.0f
+#define ELASTIC_MU 20.0f
+
 namespace vkm {
 
   struct alignas(16) ComputeParticle {
     float deltaT;  // Frame delta time
-    float particleCount;
     float elastic_lambda;
     float elastic_mu;
   };
@@ -0,0 +1,23 @@
+#ifndef EMITTER_HPP
+#define EMITTER_HPP
+
+#include <glm/glm.hpp>
+#include <cstdint>  // for uint32_t
+
+namespace vkm {
+
+  enum class EmitterShape : uint32_t { Box, Disc };
+
+  // Source of particles, same as the Emitter struct of emit_particles.comp. Each frame, its rate of particles is placed
+  // at random in its shape.
+  struct Emitter {
+    glm::vec2 center;    // in cells
+    glm::vec2 size;      // half extents of the box, or radius of the disc in x
+    glm::vec2 velocity;  // of the emitted particles, in cells per time unit
+    EmitterShape shape;
+    uint32_t rate;  // particles per frame
+  };
+
+}  // namespace vkm
+
+#endif  // EMITTER_HPP
@@ -0,0 +1,34 @@
+#ifndef PARTICLECOUNTER_HPP
+#define PARTICLECOUNTER_HPP
+
+#include <poike/poike.hpp>
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint32_t
+
+namespace vkm {
+
+  // Indirect dispatches over the live particles, one per workgroup size of the particle passes
+  enum class ParticleDispatch { Default, P2G, G2P, Count };
+
+  // Live particles, the first ones of the particle buffers, and the indirect commands which cover them. Same as the
+  // ParticleCount block of particle_storage.glsl, written by particle_count.comp. With SimulationConfig::outflow, the
+  // lists of the particle removal follow (see particle_remove.glsl).
+  struct ParticleCounter {
+    uint32_t count;
+    uint32_t capacity;  // particles which fit in the buffers
+
+    // Since the last count: the particles removed, the holes they leave before the new end of the particles and those
+    // filled, then the particles emitted
+    uint32_t removed;
+    uint32_t holes;
+    uint32_t moved;
+    uint32_t emitted;
+    uint32_t sequence;  // particles emitted since the initialisation, which seeds their placement
+
+    VkDispatchIndirectCommand dispatches[static_cast<size_t>(ParticleDispatch::Count)];
+    VkDrawIndirectCommand draw;
+  };
+
+}  // namespace vkm
+
+#endif  // PARTICLECOUNTER_HPP
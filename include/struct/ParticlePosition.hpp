@@ -0,0 +1,39 @@
+#ifndef PARTICLE_POSITION_HPP
+#define PARTICLE_POSITION_HPP
+
+#include <poike/poike.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vkm {
+  // Vertex of the structure-of-arrays layout: the position stream alone, see Particle for the full record
+  struct ParticlePosition {
+    glm::vec2 pos;
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+      VkVertexInputBindingDescription bindingDescription{};
+      bindingDescription.binding   = 0;
+      bindingDescription.stride    = sizeof(ParticlePosition);
+      bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+      return bindingDescription;
+    }
+
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() {
+      std::vector<VkVertexInputAttributeDescription> attributeDescriptions = {
+          // position
+          {
+              .location = 0,
+              .binding  = 0,
+              .format   = VK_FORMAT_R32G32_SFLOAT,
+              .offset   = offsetof(ParticlePosition, pos),
+          },
+      };
+
+      return attributeDescriptions;
+    }
+  };
+
+}  // namespace vkm
+
+#endif  // PARTICLE_POSITION_HPP
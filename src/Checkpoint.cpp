@@ -0,0 +1,208 @@
+// clang-format off
+#include <Checkpoint.hpp>
+#include <Compute/MPMStorageBuffer.hpp>                  // for MPMStorageBuffer
+#include <struct/ParticleCounter.hpp>                    // for ParticleCounter
+#include <algorithm>                                     // for max, min
+#include <cstring>                                       // for memcmp, memcpy
+#include <filesystem>                                    // for rename
+#include <fstream>                                       // for ifstream, ofstream
+#include <stdexcept>                                     // for runtime_error
+#include <system_error>                                  // for error_code
+#include <poike/poike.hpp>
+// clang-format on
+
+using namespace vkm;
+using namespace poike;
+
+Checkpoint::Checkpoint(const Device& device,
+                       const CommandPool& commandPool,
+                       const ComputeCommandBuffer& commandBuffer,
+                       const SimulationConfig& config)
+    : m_device(device), m_commandPool(commandPool), m_commandBuffer(commandBuffer), m_config(config) {}
+
+Checkpoint::~Checkpoint() { release(); }
+
+bool Checkpoint::save(const std::string& filename, const ComputeParticle& parameters) {
+  if (writing()) return false;
+
+  // The counter, then each stream up to the capacity (see ComputeCommandBuffer::recordStateCopy)
+  VkDeviceSize size = sizeof(ParticleCounter);
+  for (const MPMStorageBuffer::ParticleStream& stream : MPMStorageBuffer::particleStreams(m_config)) {
+    size += m_config.particleCapacity() * stream.stride;
+  }
+
+  m_staging.emplace(m_device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  vkMapMemory(m_device.logical(), m_staging->memory(), 0, size, 0, &m_stagingData);
+
+  const VkCommandBufferAllocateInfo allocInfo = {
+      .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool        = m_commandPool.handle(),
+      .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+
+  if (vkAllocateCommandBuffers(m_device.logical(), &allocInfo, &m_copyCommand) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate command buffers!");
+  }
+
+  const VkCommandBufferBeginInfo beginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+
+  if (vkBeginCommandBuffer(m_copyCommand, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording command buffer!");
+  }
+  m_commandBuffer.recordStateCopy(m_copyCommand, *m_staging, MPMStorageBuffer::particleStreams(m_config));
+  if (vkEndCommandBuffer(m_copyCommand) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+
+  const VkFenceCreateInfo fenceInfo = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+  };
+
+  if (vkCreateFence(m_device.logical(), &fenceInfo, nullptr, &m_copyFence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create fence!");
+  }
+
+  // In submission order after the steps, and before the next ones
+  const VkSubmitInfo submitInfo = {
+      .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .commandBufferCount = 1,
+      .pCommandBuffers    = &m_copyCommand,
+  };
+
+  if (vkQueueSubmit(m_device.computeQueue(), 1, &submitInfo, m_copyFence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit checkpoint command buffer!");
+  }
+
+  // The writer only waits for the copy, the queue and the command pool stay on this thread
+  m_written = false;
+  m_writer  = std::thread([this, filename, parameters, config = m_config]() {
+    vkWaitForFences(m_device.logical(), 1, &m_copyFence, VK_TRUE, UINT64_MAX);
+    m_failed  = !write(filename, static_cast<const char*>(m_stagingData), config, parameters);
+    m_written = true;
+  });
+
+  return true;
+}
+
+bool Checkpoint::writing() {
+  if (!m_writer.joinable()) return false;
+  if (!m_written) return true;
+
+  release();
+  return false;
+}
+
+void Checkpoint::wait() { release(); }
+
+void Checkpoint::release() {
+  if (m_writer.joinable()) m_writer.join();
+
+  if (m_stagingData) {
+    vkUnmapMemory(m_device.logical(), m_staging->memory());
+    m_stagingData = nullptr;
+  }
+  if (m_copyCommand != VK_NULL_HANDLE) {
+    vkFreeCommandBuffers(m_device.logical(), m_commandPool.handle(), 1, &m_copyCommand);
+    m_copyCommand = VK_NULL_HANDLE;
+  }
+  if (m_copyFence != VK_NULL_HANDLE) {
+    vkDestroyFence(m_device.logical(), m_copyFence, nullptr);
+    m_copyFence = VK_NULL_HANDLE;
+  }
+  m_staging.reset();
+}
+
+bool Checkpoint::write(const std::string& filename,
+                       const char* data,
+                       const SimulationConfig& config,
+                       const ComputeParticle& parameters) {
+  ParticleCounter counter;
+  std::memcpy(&counter, data, sizeof(counter));
+  const uint32_t count = std::min(counter.count, config.particleCapacity());
+
+  CheckpointHeader header = {
+      .version        = version,
+      .layout         = static_cast<uint32_t>(config.layout),
+      .gridResolution = config.gridResolution,
+      .count          = count,
+      .sequence       = counter.sequence,
+      .parameters     = parameters,
+  };
+  std::memcpy(header.magic, magic, sizeof(magic));
+
+  // Written next to the file then renamed, so that a run stopped meanwhile leaves the previous checkpoint whole
+  const std::string temporary = filename + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // only the live particles of each stream
+    const char* stream = data + sizeof(ParticleCounter);
+    for (const MPMStorageBuffer::ParticleStream& particleStream : MPMStorageBuffer::particleStreams(config)) {
+      file.write(stream, count * particleStream.stride);
+      stream += config.particleCapacity() * particleStream.stride;
+    }
+
+    if (!file) return false;
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporary, filename, error);
+  return !error;
+}
+
+CheckpointHeader Checkpoint::readHeader(std::istream& file,
+                                        const std::string& filename,
+                                        const SimulationConfig& config) {
+  CheckpointHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+      || std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+    throw std::runtime_error("not a checkpoint file: " + filename);
+  }
+
+  if (header.version != version) {
+    throw std::runtime_error("the checkpoint was saved by another version: " + filename);
+  }
+
+  // the positions are in cells, and the streams depend on the layout
+  if (header.layout != static_cast<uint32_t>(config.layout) || header.gridResolution != config.gridResolution) {
+    throw std::runtime_error("the checkpoint was saved with another particle layout or grid resolution!");
+  }
+
+  if (header.count > config.particleCapacity()) {
+    throw std::runtime_error("the particles of the checkpoint don't fit in the buffers!");
+  }
+
+  return header;
+}
+
+ComputeParticle Checkpoint::load(const std::string& filename) const {
+  std::ifstream file(filename, std::ios::binary);
+  const CheckpointHeader header = readHeader(file, filename, m_config);
+
+  VkDeviceSize size = 0;
+  for (const MPMStorageBuffer::ParticleStream& stream : MPMStorageBuffer::particleStreams(m_config)) {
+    size += header.count * stream.stride;
+  }
+
+  // The streams are read straight into the memory the device copies from
+  StorageBuffer staging(m_device, std::max<VkDeviceSize>(size, 1), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  void* data;
+  vkMapMemory(m_device.logical(), staging.memory(), 0, VK_WHOLE_SIZE, 0, &data);
+  const bool read = static_cast<bool>(file.read(static_cast<char*>(data), static_cast<std::streamsize>(size)));
+  vkUnmapMemory(m_device.logical(), staging.memory());
+
+  if (!read) {
+    throw std::runtime_error("truncated checkpoint file: " + filename);
+  }
+
+  m_commandBuffer.restore(staging, header.count, header.sequence);
+  return header.parameters;
+}
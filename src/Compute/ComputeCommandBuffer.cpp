@@ -5,6 +5,10 @@
 #include <Compute/ComputePipeline.hpp>  // for ComputePipeline
 #include <poike/poike.hpp>
 #include <Compute/MPMStorageBuffer.hpp>
+#include <Graphic/ParticleRenderBuffers.hpp>
+#include <struct/ParticleCounter.hpp>      // for ParticleCounter, ParticleDispatch
+#include <struct/Emitter.hpp>              // for Emitter
+#include <cstddef>                          // for offsetof
 // clang-format on
 
 // https://community.khronos.org/t/why-i-am-getting-this-validator-message-memory-buffer-barrier/106638
@@ -14,55 +18,174 @@ using namespace poike;
 using namespace vkm;
 
 ComputeCommandBuffer::ComputeCommandBuffer(const Device& device,
-                                           const RenderPass& renderPass,
                                            const ComputePipeline& computePipeline,
                                            const std::vector<const IBuffer*>& storageBuffers,
                                            const CommandPool& commandPool,
-                                           const DescriptorSets& descriptorSets)
+                                           const ComputeDescriptorSets& descriptorSets,
+                                           const SimulationConfig& config,
+                                           const GpuProfiler* profiler,
+                                           const std::vector<const IBuffer*>& renderBuffers)
     : m_device(device),
-      m_renderPass(renderPass),
       m_computePipeline(computePipeline),
       m_storageBuffers(storageBuffers),
+      m_renderBuffers(renderBuffers),
       m_commandPool(commandPool),
-      m_descriptorSets(descriptorSets) {
+      m_descriptorSets(descriptorSets),
+      m_config(config),
+      m_profiler(profiler) {
   createCommandBuffers();
+}
 
-  const std::optional<uint32_t>& graphicsFamily = device.queueFamilyIndices().graphicsFamily;
-  const std::optional<uint32_t>& computeFamily  = device.queueFamilyIndices().computeFamily;
+void ComputeCommandBuffer::initialise() const {
+  // the clear pass is the one of a step, with its own workgroup size
+  const uint32_t clearGroups = m_config.numGroups(m_config.numGridCells(), StepPass::ClearGrid);
+
+  CommandBuffers::SingleTimeCommands(
+      m_device, m_commandPool, m_device.computeQueue(), [&](const VkCommandBuffer& cmdBuffer) {
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.layout(), 0, 1,
+                                &m_descriptorSets.descriptor(0), 0, 0);
+
+        // Each pass reads what the previous one wrote
+        const VkMemoryBarrier passBarrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+
+        // The live particles start with those of the configuration in each instance, the passes over them are
+        // dispatched from the counter
+        const ParticleCounter counter = {
+            .count    = m_config.numParticles * m_config.instances,
+            .capacity = m_config.particleCapacity(),
+        };
+        vkCmdUpdateBuffer(cmdBuffer, m_storageBuffers[9]->buffer(), 0, sizeof(ParticleCounter), &counter);
+        if (!m_config.emitters.empty()) {
+          vkCmdUpdateBuffer(cmdBuffer, m_storageBuffers[10]->buffer(), 0, m_config.emitters.size() * sizeof(Emitter),
+                            m_config.emitters.data());
+        }
+        recordParticleCount(cmdBuffer);
+
+        // Particles in their box and cleared grid, both passes are independent
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(4));
+        recordParticleDispatch(cmdBuffer, ParticleDispatch::Default);
+        if (m_config.gridMode == GridMode::Sparse) {
+          // no active block yet, the whole pool is cleared
+          vkCmdFillBuffer(cmdBuffer, m_storageBuffers[1]->buffer(), 0, VK_WHOLE_SIZE, 0);
+        } else {
+          vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(0));
+          vkCmdDispatch(cmdBuffer, clearGroups, 1, 1);
+        }
+
+        const VkMemoryBarrier clearBarrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+        if (m_config.gridMode == GridMode::Sparse) {
+          recordMarkBlocks(cmdBuffer);
+        }
+
+        // MPM course, equation 152: scatter the particle mass to the grid, their volume is still 0 so there is no
+        // stress contribution
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(1));
+        if (m_computePipeline.p2gMode() == P2GMode::Serial) {
+          vkCmdDispatch(cmdBuffer, 1, 1, 1);
+        } else {
+          recordParticleDispatch(cmdBuffer, ParticleDispatch::P2G);
+        }
+
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &passBarrier, 0, nullptr, 0, nullptr);
+
+        // and gather it back as a density, to estimate the initial volume of each particle
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(5));
+        recordParticleDispatch(cmdBuffer, ParticleDispatch::Default);
+
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             1, &passBarrier, 0, nullptr, 0, nullptr);
+      });
+}
 
-  // Transfer
-  if (graphicsFamily.value() != computeFamily.value()) {
-    CommandBuffers::SingleTimeCommands(
-        m_device, m_commandPool, m_device.computeQueue(), [&](const VkCommandBuffer& cmdBuffer) {
-          const VkBufferMemoryBarrier acquire_buffer_barrier = {
-              .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-              .srcAccessMask       = 0,
-              .dstAccessMask       = VK_ACCESS_SHADER_WRITE_BIT,
-              .srcQueueFamilyIndex = graphicsFamily.value(),
-              .dstQueueFamilyIndex = computeFamily.value(),
-              .buffer              = m_storageBuffers[0]->buffer(),
-              .offset              = 0,
-              .size                = m_storageBuffers[0]->size(),
+void ComputeCommandBuffer::restore(const IBuffer& staging, uint32_t count, uint32_t sequence) const {
+  CommandBuffers::SingleTimeCommands(
+      m_device, m_commandPool, m_device.computeQueue(), [&](const VkCommandBuffer& cmdBuffer) {
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.layout(), 0, 1,
+                                &m_descriptorSets.descriptor(0), 0, 0);
+
+        const ParticleCounter counter = {
+            .count    = count,
+            .capacity = m_config.particleCapacity(),
+            .sequence = sequence,
+        };
+        vkCmdUpdateBuffer(cmdBuffer, m_storageBuffers[9]->buffer(), 0, sizeof(ParticleCounter), &counter);
+
+        VkDeviceSize offset = 0;
+        for (const MPMStorageBuffer::ParticleStream& stream : MPMStorageBuffer::particleStreams(m_config)) {
+          const VkBufferCopy region = {
+              .srcOffset = offset,
+              .dstOffset = 0,
+              .size      = count * stream.stride,
           };
+          if (region.size > 0) {
+            vkCmdCopyBuffer(cmdBuffer, staging.buffer(), m_storageBuffers[stream.buffer]->buffer(), 1, &region);
+          }
+          offset += region.size;
+        }
+
+        // the passes over the restored particles are dispatched from their count
+        recordParticleCount(cmdBuffer);
+      });
+}
 
-          vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
-                               0, nullptr, 1, &acquire_buffer_barrier, 0, nullptr);
-
-          const VkBufferMemoryBarrier release_buffer_barrier = {
-              .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-              .srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT,
-              .dstAccessMask       = 0,
-              .srcQueueFamilyIndex = computeFamily.value(),
-              .dstQueueFamilyIndex = graphicsFamily.value(),
-              .buffer              = m_storageBuffers[0]->buffer(),
-              .offset              = 0,
-              .size                = m_storageBuffers[0]->size(),
-          };
+void ComputeCommandBuffer::recordStateCopy(VkCommandBuffer cmdBuffer,
+                                           const IBuffer& staging,
+                                           const std::vector<MPMStorageBuffer::ParticleStream>& streams) const {
+  // The steps write the particles and the count, the render copy only reads them
+  const VkMemoryBarrier stepBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                       &stepBarrier, 0, nullptr, 0, nullptr);
 
-          vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
-                               0, nullptr, 1, &release_buffer_barrier, 0, nullptr);
-        });
+  // The number of live particles is only known once copied, so the streams are copied up to the capacity
+  const VkBufferCopy counterRegion = {
+      .size = sizeof(ParticleCounter),
+  };
+  vkCmdCopyBuffer(cmdBuffer, m_storageBuffers[9]->buffer(), staging.buffer(), 1, &counterRegion);
+
+  VkDeviceSize offset = sizeof(ParticleCounter);
+  for (const MPMStorageBuffer::ParticleStream& stream : streams) {
+    const VkBufferCopy region = {
+        .srcOffset = 0,
+        .dstOffset = offset,
+        .size      = m_config.particleCapacity() * stream.stride,
+    };
+    vkCmdCopyBuffer(cmdBuffer, m_storageBuffers[stream.buffer]->buffer(), staging.buffer(), 1, &region);
+    offset += region.size;
   }
+
+  // Read on the host once the fence of the submission is signaled
+  const VkMemoryBarrier hostBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0,
+                       nullptr, 0, nullptr);
+}
+
+void ComputeCommandBuffer::fillRenderBuffer(size_t renderBuffer) const {
+  CommandBuffers::SingleTimeCommands(
+      m_device, m_commandPool, m_device.computeQueue(),
+      [&](const VkCommandBuffer& cmdBuffer) { recordRenderCopy(cmdBuffer, *m_renderBuffers.at(renderBuffer)); });
 }
 
 void ComputeCommandBuffer::recreate() {
@@ -71,7 +194,14 @@ void ComputeCommandBuffer::recreate() {
 }
 
 void ComputeCommandBuffer::destroyCommandBuffers() {
-  vkFreeCommandBuffers(m_device.logical(), m_commandPool.handle(), 1, &m_commandBuffer);
+  vkFreeCommandBuffers(m_device.logical(), m_commandPool.handle(), static_cast<uint32_t>(m_commandBuffers.size()),
+                       m_commandBuffers.data());
+  m_commandBuffers.clear();
+  if (!m_sortedCommandBuffers.empty()) {
+    vkFreeCommandBuffers(m_device.logical(), m_commandPool.handle(),
+                         static_cast<uint32_t>(m_sortedCommandBuffers.size()), m_sortedCommandBuffers.data());
+    m_sortedCommandBuffers.clear();
+  }
 }
 
 VkCommandBuffer ComputeCommandBuffer::allocCommandBuffer(VkCommandBufferLevel level,
@@ -92,8 +222,10 @@ VkCommandBuffer ComputeCommandBuffer::allocCommandBuffer(VkCommandBufferLevel le
 
   // If requested, also start recording for the new command buffer
   if (begin) {
+    // The headless simulation submits the same command buffer several times in a row
     const VkCommandBufferBeginInfo cmdBufInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
     };
 
     if (vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo) != VK_SUCCESS) {
@@ -105,42 +237,175 @@ VkCommandBuffer ComputeCommandBuffer::allocCommandBuffer(VkCommandBufferLevel le
 }
 
 void ComputeCommandBuffer::createCommandBuffers() {
+  // The frames alternate between the render buffers, the headless simulation has none
+  const size_t count = m_renderBuffers.empty() ? 1 : m_renderBuffers.size();
+
+  for (size_t i = 0; i < count; ++i) {
+    const IBuffer* renderBuffer = m_renderBuffers.empty() ? nullptr : m_renderBuffers[i];
+    // the steps submitted with it read the copy of the uniform buffer of their index
+    const size_t descriptorSet = i % m_descriptorSets.size();
+    m_commandBuffers.push_back(recordCommandBuffer(false, renderBuffer, descriptorSet));
+
+    // The same steps after a sort of the particles, submitted every sortInterval frames instead of the other one
+    if (m_config.sortInterval > 0) {
+      m_sortedCommandBuffers.push_back(recordCommandBuffer(true, renderBuffer, descriptorSet));
+    }
+  }
+}
+
+VkCommandBuffer ComputeCommandBuffer::recordCommandBuffer(bool sort,
+                                                          const IBuffer* renderBuffer,
+                                                          size_t descriptorSet) const {
+  // Build a single command buffer containing the compute dispatch commands
+  VkCommandBuffer cmdBuffer = allocCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_commandPool.handle(), true);
+
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.layout(), 0, 1,
+                          &m_descriptorSets.descriptor(descriptorSet), 0, 0);
+
+  // The particles which left the domain are replaced by the last ones, then the emitters add theirs
+  if (m_config.outflow) {
+    recordRemove(cmdBuffer);
+  }
+  if (!m_config.emitters.empty()) {
+    recordEmit(cmdBuffer);
+  }
+  recordParticleCount(cmdBuffer);
+
+  if (sort) {
+    recordSort(cmdBuffer);
+  }
+
+  // After the passes above, which would otherwise be timed as the first ClearGrid
+  if (m_profiler) m_profiler->beginCompute(cmdBuffer);
+
+  // Several simulation steps per submission, so that a smaller dt doesn't slow down the rendering
+  for (uint32_t i = 0; i < m_config.substeps; ++i) {
+    recordStep(cmdBuffer, i);
+  }
+
+  // The particle buffer stays on the compute queue, the graphics queue draws a copy of it
+  if (renderBuffer) {
+    recordRenderCopy(cmdBuffer, *renderBuffer);
+  }
+
+  if (vkEndCommandBuffer(cmdBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+
+  return cmdBuffer;
+}
+
+void ComputeCommandBuffer::recordRenderCopy(VkCommandBuffer cmdBuffer, const IBuffer& renderBuffer) const {
   const std::optional<uint32_t>& graphicsFamily = m_device.queueFamilyIndices().graphicsFamily;
   const std::optional<uint32_t>& computeFamily  = m_device.queueFamilyIndices().computeFamily;
 
-  // Build a single command buffer containing the compute dispatch commands
-  m_commandBuffer = allocCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_commandPool.handle(), true);
+  // Wait for G2P to write the particles, and for the draw command of the live ones
+  const VkBufferMemoryBarrier copyBarriers[] = {
+      {
+          .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+          .srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT,
+          .dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .buffer              = m_storageBuffers[0]->buffer(),
+          .size                = m_storageBuffers[0]->descriptor().range,
+      },
+      {
+          .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+          .srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT,
+          .dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .buffer              = m_storageBuffers[9]->buffer(),
+          .size                = m_storageBuffers[9]->descriptor().range,
+      },
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                       nullptr, 2, copyBarriers, 0, nullptr);
 
-  // Here, we need barrier if we doen't have graphic and compute on the same queue
+  // The previous content of the render buffer is discarded, so the compute queue writes it without acquiring it back
+  // from the graphics queue. It starts with the draw command.
+  const VkBufferCopy drawRegion = {
+      .srcOffset = offsetof(ParticleCounter, draw),
+      .dstOffset = 0,
+      .size      = sizeof(VkDrawIndirectCommand),
+  };
+  vkCmdCopyBuffer(cmdBuffer, m_storageBuffers[9]->buffer(), renderBuffer.buffer(), 1, &drawRegion);
+
+  const VkBufferCopy particleRegion = {
+      .srcOffset = 0,
+      .dstOffset = ParticleRenderBuffers::drawCommandSize,
+      .size      = renderBuffer.size() - ParticleRenderBuffers::drawCommandSize,
+  };
+  vkCmdCopyBuffer(cmdBuffer, m_storageBuffers[0]->buffer(), renderBuffer.buffer(), 1, &particleRegion);
 
-  // Acquire barrier
+  // Release barrier
   if (graphicsFamily.value() != computeFamily.value()) {
-    const VkBufferMemoryBarrier acquire_barrier = {
+    const VkBufferMemoryBarrier release_barrier = {
         .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-        .srcAccessMask       = 0,
-        .dstAccessMask       = VK_ACCESS_SHADER_WRITE_BIT,
-        .srcQueueFamilyIndex = graphicsFamily.value(),
-        .dstQueueFamilyIndex = computeFamily.value(),
-        .buffer              = m_storageBuffers[0]->buffer(),
+        .srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask       = 0,
+        .srcQueueFamilyIndex = computeFamily.value(),
+        .dstQueueFamilyIndex = graphicsFamily.value(),
+        .buffer              = renderBuffer.buffer(),
         .offset              = 0,
-        .size                = m_storageBuffers[0]->size(),
+        .size                = renderBuffer.size(),
     };
 
-    vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
-                         0, nullptr, 1, &acquire_barrier, 0, nullptr);
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr,
+                         1, &release_barrier, 0, nullptr);
   }
+}
+
+void ComputeCommandBuffer::recordStep(VkCommandBuffer cmdBuffer, uint32_t substep) const {
+  // The fused passes clear the dense grid with a fill, and G2P does the work of the update grid pass
+  const bool fillGrid = m_config.fuseGridPasses && m_config.gridMode == GridMode::Dense;
+
+  // Wait for the previous step (G2P writes the particles read by this step, the sparse grid is cleared from the blocks
+  // it marked), either the previous substep or the previous submission, and its copy to a render buffer
+  const VkMemoryBarrier stepBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+                       | VK_ACCESS_TRANSFER_WRITE_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+                           | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 1, &stepBarrier, 0, nullptr, 0, nullptr);
 
   // First pass: Clear Grid
   // -------------------------------------------------------------------------------------------------------
-  vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(0));
-  vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.layout(), 0, 1,
-                          &m_descriptorSets.descriptor(0), 0, 0);
-  vkCmdDispatch(m_commandBuffer, NUM_CELLS / 256, 1, 1);
+  if (fillGrid) {
+    vkCmdFillBuffer(cmdBuffer, m_storageBuffers[1]->buffer(), 0, VK_WHOLE_SIZE, 0);
+  } else {
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(0));
+    recordGridDispatch(cmdBuffer, StepPass::ClearGrid);
+  }
+
+  // The sparse grid clears the blocks of the previous step, then gives a slot to those of this step. It is timed with
+  // the clear.
+  if (m_config.gridMode == GridMode::Sparse) {
+    const VkMemoryBarrier clearBarrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    recordMarkBlocks(cmdBuffer);
+  }
+
+  if (m_profiler) m_profiler->endComputePass(cmdBuffer, substep, GpuPass::ClearGrid);
 
   // Add memory barrier to ensure that the computer shader has finished writing to the buffer
   const VkBufferMemoryBarrier bufferBarrier1 = {
       .sType         = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .srcAccessMask = fillGrid ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_WRITE_BIT,
       .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
       // Transfer ownership if compute and graphics queue family indices differ
       .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
@@ -149,13 +414,18 @@ void ComputeCommandBuffer::createCommandBuffers() {
       .size                = m_storageBuffers[1]->descriptor().range,
   };
 
-  vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
-                       0, nullptr, 1, &bufferBarrier1, 0, nullptr);
+  vkCmdPipelineBarrier(cmdBuffer, fillGrid ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier1, 0, nullptr);
 
   // Second pass: P2G
   // -------------------------------------------------------------------------------------------------------
-  vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(1));
-  vkCmdDispatch(m_commandBuffer, 1, 1, 1);
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(1));
+  if (m_computePipeline.p2gMode() == P2GMode::Serial) {
+    vkCmdDispatch(cmdBuffer, 1, 1, 1);
+  } else {
+    recordParticleDispatch(cmdBuffer, ParticleDispatch::P2G);
+  }
+  if (m_profiler) m_profiler->endComputePass(cmdBuffer, substep, GpuPass::P2G);
 
   // Add memory barrier to ensure that the computer shader has finished writing to the buffer
   const VkBufferMemoryBarrier bufferBarrier2 = {
@@ -169,55 +439,225 @@ void ComputeCommandBuffer::createCommandBuffers() {
       .size                = m_storageBuffers[1]->descriptor().range,
   };
 
-  vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
                        0, nullptr, 1, &bufferBarrier2, 0, nullptr);
 
   // 3 pass: Update Grid
   // -------------------------------------------------------------------------------------------------------
-  vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(2));
-  vkCmdDispatch(m_commandBuffer, NUM_CELLS / 256, 1, 1);
+  // Skipped by the fused passes, its timestamp still follows the P2G one
+  if (!m_config.fuseGridPasses) {
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(2));
+    recordGridDispatch(cmdBuffer, StepPass::UpdateGrid);
+  }
+  if (m_profiler) m_profiler->endComputePass(cmdBuffer, substep, GpuPass::UpdateGrid);
+
+  if (!m_config.fuseGridPasses) {
+    // Add memory barrier to ensure that the computer shader has finished writing to the buffer
+    const VkBufferMemoryBarrier bufferBarrier3 = {
+        .sType         = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        // Transfer ownership if compute and graphics queue family indices differ
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer              = m_storageBuffers[1]->buffer(),
+        .size                = m_storageBuffers[1]->descriptor().range,
+    };
 
-  // Add memory barrier to ensure that the computer shader has finished writing to the buffer
-  const VkBufferMemoryBarrier bufferBarrier3 = {
-      .sType         = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         0, nullptr, 1, &bufferBarrier3, 0, nullptr);
+  }
+
+  // 4 pass: G2P
+  // -------------------------------------------------------------------------------------------------------
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(3));
+  recordParticleDispatch(cmdBuffer, ParticleDispatch::G2P);
+  if (m_profiler) m_profiler->endComputePass(cmdBuffer, substep, GpuPass::G2P);
+
+  // No barrier after G2P: the next substep, the render copy and the next submission each start with their own
+}
+
+void ComputeCommandBuffer::recordSort(VkCommandBuffer cmdBuffer) const {
+  // The previous submission wrote the particles, and read the histogram if it sorted them too
+  const VkMemoryBarrier transferBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
       .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-      // Transfer ownership if compute and graphics queue family indices differ
-      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-      .buffer              = m_storageBuffers[1]->buffer(),
-      .size                = m_storageBuffers[1]->descriptor().range,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
   };
 
-  vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
-                       0, nullptr, 1, &bufferBarrier3, 0, nullptr);
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                       &transferBarrier, 0, nullptr, 0, nullptr);
 
-  // 4 pass: G2P
-  // -------------------------------------------------------------------------------------------------------
-  vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(3));
-  vkCmdDispatch(m_commandBuffer, NUM_PARTICLE / 256, 1, 1);
+  // Empty histogram
+  vkCmdFillBuffer(cmdBuffer, m_storageBuffers[7]->buffer(), 0, m_config.numSortKeys() * sizeof(int32_t), 0);
 
-  // vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0,
-  //                      nullptr, 0, nullptr, 0, nullptr);
+  const VkMemoryBarrier fillBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
 
-  // Release barrier
-  if (graphicsFamily.value() != computeFamily.value()) {
-    const VkBufferMemoryBarrier release_barrier = {
-        .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-        .srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT,
-        .dstAccessMask       = 0,
-        .srcQueueFamilyIndex = computeFamily.value(),
-        .dstQueueFamilyIndex = graphicsFamily.value(),
-        .buffer              = m_storageBuffers[0]->buffer(),
-        .offset              = 0,
-        .size                = m_storageBuffers[0]->size(),
-    };
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &fillBarrier, 0, nullptr, 0, nullptr);
 
-    vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
-                         0, nullptr, 1, &release_barrier, 0, nullptr);
+  // Each pass reads what the previous one wrote
+  const VkMemoryBarrier passBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
+
+  // Keys and histogram, first sorted index of each key, particles in sorted order, then copied back
+  for (uint32_t pass = 0; pass < 4; ++pass) {
+    if (pass > 0) {
+      vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                           1, &passBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(7 + pass));
+    if (pass == 1) {
+      // a single workgroup scans the histogram
+      vkCmdDispatch(cmdBuffer, 1, 1, 1);
+    } else {
+      recordParticleDispatch(cmdBuffer, ParticleDispatch::Default);
+    }
   }
+}
 
-  if (vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS) {
-    throw std::runtime_error("failed to record command buffer!");
+void ComputeCommandBuffer::recordGridDispatch(VkCommandBuffer cmdBuffer, StepPass pass) const {
+  if (m_config.gridMode == GridMode::Sparse) {
+    // the header of the blocks buffer covers the cells of the active blocks
+    vkCmdDispatchIndirect(cmdBuffer, m_storageBuffers[3]->buffer(), 0);
+  } else {
+    // the shaders discard the extra invocations
+    vkCmdDispatch(cmdBuffer, m_config.numGroups(m_config.numGridCells(), pass), 1, 1);
   }
 }
+
+void ComputeCommandBuffer::recordMarkBlocks(VkCommandBuffer cmdBuffer) const {
+  const VkBuffer blocks = m_storageBuffers[3]->buffer();
+
+  // The previous passes use the header and the tables (the clear pass, or the previous step)
+  const VkMemoryBarrier transferBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &transferBarrier, 0, nullptr, 0, nullptr);
+
+  // No workgroup nor active block, and no block has a slot
+  const uint32_t header[] = {0, 1, 1, 0};
+  vkCmdUpdateBuffer(cmdBuffer, blocks, 0, sizeof(header), header);
+  vkCmdFillBuffer(cmdBuffer, blocks, MPMStorageBuffer::blocksHeaderSize, m_config.numBlocks() * sizeof(int32_t),
+                  0xFFFFFFFF);
+
+  const VkMemoryBarrier resetBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &resetBarrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(6));
+  recordParticleDispatch(cmdBuffer, ParticleDispatch::Default);
+
+  // P2G reads the slots, and the grid passes are dispatched from the header
+  const VkMemoryBarrier markBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &markBarrier,
+                       0, nullptr, 0, nullptr);
+}
+
+void ComputeCommandBuffer::recordRemove(VkCommandBuffer cmdBuffer) const {
+  // The previous submission wrote the particles, and copied them to a render buffer
+  const VkMemoryBarrier transferBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &transferBarrier, 0, nullptr, 0, nullptr);
+
+  // Each pass reads the lists of the previous one
+  const VkMemoryBarrier passBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
+
+  // Particles out of the domain, holes they leave, then the last particles moved to them. Each pass has at most one
+  // invocation per live particle.
+  for (uint32_t pass = 0; pass < 3; ++pass) {
+    if (pass > 0) {
+      vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                           1, &passBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(12 + pass));
+    recordParticleDispatch(cmdBuffer, ParticleDispatch::Default);
+  }
+}
+
+void ComputeCommandBuffer::recordEmit(VkCommandBuffer cmdBuffer) const {
+  // The emitted particles are written after the live ones, which the removal may have just moved
+  const VkMemoryBarrier emitBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &emitBarrier, 0, nullptr, 0, nullptr);
+
+  // One invocation per particle emitted in a frame, the shader skips those which don't fit
+  const uint32_t groups = (m_config.emissionRate() + m_config.workgroupSize - 1) / m_config.workgroupSize;
+
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(15));
+  vkCmdDispatch(cmdBuffer, groups, 1, 1);
+}
+
+void ComputeCommandBuffer::recordParticleCount(VkCommandBuffer cmdBuffer) const {
+  // The count is written by a transfer or a shader, and the previous commands may still be read (the passes of the
+  // previous submission, its copy to a render buffer)
+  const VkMemoryBarrier countBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT
+                           | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &countBarrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline.pipeline(11));
+  vkCmdDispatch(cmdBuffer, 1, 1, 1);
+
+  // The next passes are dispatched from the commands, and read the count
+  const VkMemoryBarrier commandsBarrier = {
+      .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+  };
+
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1,
+                       &commandsBarrier, 0, nullptr, 0, nullptr);
+}
+
+void ComputeCommandBuffer::recordParticleDispatch(VkCommandBuffer cmdBuffer, ParticleDispatch dispatch) const {
+  // the shaders discard the extra invocations of the last workgroup
+  const VkDeviceSize offset
+      = offsetof(ParticleCounter, dispatches) + static_cast<size_t>(dispatch) * sizeof(VkDispatchIndirectCommand);
+  vkCmdDispatchIndirect(cmdBuffer, m_storageBuffers[9]->buffer(), offset);
+}
@@ -9,10 +9,25 @@
 using namespace vkm;
 using namespace poike;
 
+std::vector<VkDescriptorSetLayoutBinding> ComputeDescriptorSets::layoutBindings(
+    const std::vector<const IBuffer*>& buffers) {
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    if (buffers[i] == nullptr) continue;
+    bindings.push_back(misc::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT,
+                                                        storageBinding(i)));
+  }
+  bindings.push_back(
+      misc::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, uniformBinding));
+
+  return bindings;
+}
+
 void ComputeDescriptorSets::createDescriptorSets() {
   {
     /* Allocate */
-    const size_t size = 1;
+    const size_t size = m_uniformBuffers.size();
 
     const std::vector<VkDescriptorSetLayout> layouts(size, m_descriptorSetLayout.handle());
     const VkDescriptorSetAllocateInfo allocInfo
@@ -26,21 +41,23 @@ void ComputeDescriptorSets::createDescriptorSets() {
 
   std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 
-  const VkDescriptorBufferInfo psInfo   = m_buffers[0]->descriptor();
-  const VkDescriptorBufferInfo gridInfo = m_buffers[1]->descriptor();
-  const VkDescriptorBufferInfo fsInfo   = m_buffers[2]->descriptor();
+  // ps, grid, fs, blocks, the structure-of-arrays streams if any, the sort buffers, the particle counter, the emitters
+  std::vector<VkDescriptorBufferInfo> storageInfos;
+  for (const IBuffer* buffer : m_buffers) {
+    storageInfos.push_back(buffer != nullptr ? buffer->descriptor() : VkDescriptorBufferInfo{});
+  }
 
-  // On paramètre les descripteurs (on se rappelle que l'on en a mit un par frame)
-  const IUniformBuffers* ubo = m_uniformBuffers[0];
   for (size_t i = 0; i < m_descriptorSets.size(); i++) {
-    const VkDescriptorBufferInfo bufferInfo = ubo->descriptor(i);
-
-    writeDescriptorSets = {
-        misc::writeDescriptorSet(m_descriptorSets.at(i), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &psInfo),
-        misc::writeDescriptorSet(m_descriptorSets.at(i), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &gridInfo),
-        misc::writeDescriptorSet(m_descriptorSets.at(i), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &fsInfo),
-        misc::writeDescriptorSet(m_descriptorSets.at(i), VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &bufferInfo),
-    };
+    const VkDescriptorBufferInfo bufferInfo = m_uniformBuffers[i]->descriptor();
+
+    writeDescriptorSets.clear();
+    for (size_t j = 0; j < storageInfos.size(); j++) {
+      if (m_buffers[j] == nullptr) continue;
+      writeDescriptorSets.push_back(misc::writeDescriptorSet(m_descriptorSets.at(i), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                             storageBinding(j), &storageInfos[j]));
+    }
+    writeDescriptorSets.push_back(misc::writeDescriptorSet(m_descriptorSets.at(i), VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                                           uniformBinding, &bufferInfo));
 
     vkUpdateDescriptorSets(m_device.logical(), static_cast<uint32_t>(writeDescriptorSets.size()),
                            writeDescriptorSets.data(), 0, nullptr);
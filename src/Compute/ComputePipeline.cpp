@@ -2,114 +2,331 @@
 #include <Compute/ComputePipeline.hpp>
 #include <clear_grid_comp.h>    
 #include <particle_to_grid_comp.h>        
+#include <particle_to_grid_comp_soa.h>
+#include <particle_to_grid_atomic_comp.h>
+#include <particle_to_grid_atomic_comp_soa.h>
+#include <particle_to_grid_tiled_comp.h>
+#include <particle_to_grid_tiled_comp_soa.h>
 #include <update_grid_comp.h>   
 #include <grid_to_particle_comp.h>   
+#include <grid_to_particle_comp_soa.h>
+#include <init_particles_comp.h>
+#include <init_particles_comp_soa.h>
+#include <particle_volume_comp.h>
+#include <particle_volume_comp_soa.h>
+#include <mark_blocks_comp.h>
+#include <mark_blocks_comp_soa.h>
+#include <sort_keys_comp.h>
+#include <sort_keys_comp_soa.h>
+#include <sort_scan_comp.h>
+#include <sort_scatter_comp.h>
+#include <sort_scatter_comp_soa.h>
+#include <sort_gather_comp.h>
+#include <sort_gather_comp_soa.h>
+#include <particle_count_comp.h>
+#include <remove_mark_comp.h>
+#include <remove_mark_comp_soa.h>
+#include <remove_holes_comp.h>
+#include <remove_fill_comp.h>
+#include <remove_fill_comp_soa.h>
+#include <emit_particles_comp.h>
+#include <emit_particles_comp_soa.h>
 #include <poike/poike.hpp>
 #include <glm/glm.hpp>
+#include <algorithm>                         // for find, max_element, min
+#include <array>                             // for array
 #include <stdexcept>                         // for runtime_error
 #include <map>
+#include <cstddef>                           // for offsetof
 #include <iostream>
+#include <iterator>                          // for size
+#include <string>                            // for string
 // clang-format on
 
 using namespace vkm;
 using namespace poike;
 
 ComputePipeline::ComputePipeline(const Device& device,
-                                 const SwapChain& swapChain,
-                                 const RenderPass& renderPass,
-                                 const DescriptorSetLayout& descriptorSetLayout)
-    : GraphicsPipeline(device, swapChain, renderPass, descriptorSetLayout), m_pipelines(4) {
-  createPipeline();
-}
+                                 const DescriptorSetLayout& descriptorSetLayout,
+                                 const SimulationConfig& config,
+                                 const PipelineCache& pipelineCache)
+    : m_device(device),
+      m_descriptorSetLayout(descriptorSetLayout),
+      m_config(config),
+      m_pipelineCache(pipelineCache) {
+  const VkDescriptorSetLayout layouts[]               = {m_descriptorSetLayout.handle()};
+  const VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+      .sType          = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts    = layouts,
+  };
 
-ComputePipeline::~ComputePipeline() { destroyComputePipeline(); }
+  if (vkCreatePipelineLayout(m_device.logical(), &pipelineLayoutInfo, nullptr, &m_layout) != VK_SUCCESS) {
+    throw std::runtime_error("Pipeline Layout creation failed");
+  }
 
-void ComputePipeline::recreate() {
-  destroyComputePipeline();
-  createPipeline();
+  recreate();
 }
 
-void ComputePipeline::destroyComputePipeline() {
-  for (size_t i = 0; i < m_pipelines.size(); i++) {
-    vkDestroyPipeline(m_device.logical(), m_pipelines[i], nullptr);
+ComputePipeline::~ComputePipeline() {
+  for (const auto& [variant, pipelines] : m_variants) {
+    destroyPipelines(pipelines);
   }
 
-  destroyPipeline();
+  vkDestroyPipelineLayout(m_device.logical(), m_layout, nullptr);
 }
 
-void ComputePipeline::createPipeline() {
-  {
-    const VkDescriptorSetLayout layouts[]               = {m_descriptorSetLayout.handle()};
-    const VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
-        .sType          = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = 1,
-        .pSetLayouts    = layouts,
-    };
+void ComputePipeline::recreate() {
+  const Variant variant = currentVariant();
 
-    if (vkCreatePipelineLayout(m_device.logical(), &pipelineLayoutInfo, nullptr, &m_layout) != VK_SUCCESS) {
-      throw std::runtime_error("Pipeline Layout creation failed");
+  auto it = m_variants.find(variant);
+  if (it == m_variants.end()) {
+    if (m_variants.size() == maxVariants) {
+      const auto evicted = m_variants.find(m_recentVariants.front());
+      destroyPipelines(evicted->second);
+      m_variants.erase(evicted);
+      m_recentVariants.erase(m_recentVariants.begin());
     }
+
+    it = m_variants.emplace(variant, createPipelines(variant)).first;
+  } else {
+    m_recentVariants.erase(std::find(m_recentVariants.begin(), m_recentVariants.end(), variant));
   }
 
-  VkComputePipelineCreateInfo computePipelineCreateInfo = {
-      .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-      .flags  = 0,
-      .layout = m_layout,
+  m_recentVariants.push_back(variant);
+  m_pipelines = &it->second;
+}
+
+ComputePipeline::Variant ComputePipeline::currentVariant() const {
+  StepWorkgroupSizes stepWorkgroupSizes;
+  for (size_t pass = 0; pass < stepWorkgroupSizes.size(); ++pass) {
+    stepWorkgroupSizes[pass] = m_config.passWorkgroupSize(static_cast<StepPass>(pass));
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(m_device.physical(), &properties);
+
+  const uint32_t maxSize
+      = std::min(properties.limits.maxComputeWorkGroupSize[0], properties.limits.maxComputeWorkGroupInvocations);
+  if (m_config.workgroupSize > maxSize
+      || *std::max_element(stepWorkgroupSizes.begin(), stepWorkgroupSizes.end()) > maxSize) {
+    throw std::runtime_error("the workgroup size is larger than the device supports!");
+  }
+
+  return {
+      .p2gMode            = m_config.p2gMode,
+      .layout             = m_config.layout,
+      .constants          = {
+          .gridResolution    = static_cast<int32_t>(m_config.gridResolution),
+          .fixedPointGrid    = (m_config.p2gMode != P2GMode::Serial) ? VK_TRUE : VK_FALSE,
+          .sparseGrid        = (m_config.gridMode == GridMode::Sparse) ? VK_TRUE : VK_FALSE,
+          .poolBlocks        = static_cast<int32_t>(m_config.numPoolBlocks()),
+          .sortKeys          = static_cast<int32_t>(m_config.numSortKeys()),
+          .fusedGridUpdate   = m_config.fuseGridPasses ? VK_TRUE : VK_FALSE,
+          .workgroupSize     = m_config.workgroupSize,
+          .gravity           = m_config.gravity,
+          .gridWorkgroupSize = static_cast<int32_t>(m_config.passWorkgroupSize(StepPass::ClearGrid)),
+          .p2gWorkgroupSize  = static_cast<int32_t>(m_config.passWorkgroupSize(StepPass::P2G)),
+          .g2pWorkgroupSize  = static_cast<int32_t>(m_config.passWorkgroupSize(StepPass::G2P)),
+          .outflow           = m_config.outflow ? VK_TRUE : VK_FALSE,
+          .instances         = static_cast<int32_t>(m_config.instances),
+          .instanceCapacity  = static_cast<int32_t>(m_config.instanceCapacity()),
+      },
+      .stepWorkgroupSizes = stepWorkgroupSizes,
   };
+}
 
-  {  // 1st pass
-    VkShaderModule compShaderModule = createShaderModule(CLEAR_GRID_COMP);
-    computePipelineCreateInfo.stage
-        = misc::pipelineShaderStageCreateInfo(compShaderModule, VK_SHADER_STAGE_COMPUTE_BIT);
+void ComputePipeline::destroyPipelines(const std::vector<VkPipeline>& pipelines) const {
+  for (size_t i = 0; i < pipelines.size(); i++) {
+    vkDestroyPipeline(m_device.logical(), pipelines[i], nullptr);
+  }
+}
 
-    if (vkCreateComputePipelines(m_device.logical(), VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr,
-                                 &m_pipelines[0])
-        != VK_SUCCESS) {
-      throw std::runtime_error("Compute Pipeline Calculate creation failed");
-    }
+VkShaderModule ComputePipeline::createShaderModule(const std::vector<unsigned char>& code) const {
+  const VkShaderModuleCreateInfo createInfo = {
+      .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = code.size(),
+      .pCode    = reinterpret_cast<const uint32_t*>(code.data()),
+  };
 
-    deleteShaderModule({computePipelineCreateInfo.stage});
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(m_device.logical(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    throw std::runtime_error("Shader Module creation failed");
   }
 
-  {  // 2nd pass
-    VkShaderModule compShaderModule = createShaderModule(PARTICLE_TO_GRID_COMP);
-    computePipelineCreateInfo.stage
-        = misc::pipelineShaderStageCreateInfo(compShaderModule, VK_SHADER_STAGE_COMPUTE_BIT);
+  return shaderModule;
+}
 
-    if (vkCreateComputePipelines(m_device.logical(), VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr,
-                                 &m_pipelines[1])
-        != VK_SUCCESS) {
-      throw std::runtime_error("Compute Pipeline Integrate creation failed");
-    }
+std::vector<VkPipeline> ComputePipeline::createPipelines(const Variant& variant) const {
+  const VkSpecializationMapEntry specializationEntries[] = {
+      {
+          .constantID = 0,
+          .offset     = offsetof(SpecializationData, gridResolution),
+          .size       = sizeof(int32_t),
+      },
+      {
+          .constantID = 1,
+          .offset     = offsetof(SpecializationData, fixedPointGrid),
+          .size       = sizeof(VkBool32),
+      },
+      {
+          .constantID = 2,
+          .offset     = offsetof(SpecializationData, sparseGrid),
+          .size       = sizeof(VkBool32),
+      },
+      {
+          .constantID = 3,
+          .offset     = offsetof(SpecializationData, poolBlocks),
+          .size       = sizeof(int32_t),
+      },
+      {
+          .constantID = 4,
+          .offset     = offsetof(SpecializationData, sortKeys),
+          .size       = sizeof(int32_t),
+      },
+      {
+          .constantID = 5,
+          .offset     = offsetof(SpecializationData, fusedGridUpdate),
+          .size       = sizeof(VkBool32),
+      },
+      {
+          .constantID = 6,  // local_size_x_id of workgroup.glsl
+          .offset     = offsetof(SpecializationData, workgroupSize),
+          .size       = sizeof(uint32_t),
+      },
+      {
+          .constantID = 7,
+          .offset     = offsetof(SpecializationData, gravity),
+          .size       = sizeof(float),
+      },
+      {
+          .constantID = 8,
+          .offset     = offsetof(SpecializationData, gridWorkgroupSize),
+          .size       = sizeof(int32_t),
+      },
+      {
+          .constantID = 9,
+          .offset     = offsetof(SpecializationData, p2gWorkgroupSize),
+          .size       = sizeof(int32_t),
+      },
+      {
+          .constantID = 10,
+          .offset     = offsetof(SpecializationData, g2pWorkgroupSize),
+          .size       = sizeof(int32_t),
+      },
+      {
+          .constantID = 11,
+          .offset     = offsetof(SpecializationData, outflow),
+          .size       = sizeof(VkBool32),
+      },
+      {
+          .constantID = 12,
+          .offset     = offsetof(SpecializationData, instances),
+          .size       = sizeof(int32_t),
+      },
+      {
+          .constantID = 13,
+          .offset     = offsetof(SpecializationData, instanceCapacity),
+          .size       = sizeof(int32_t),
+      },
+  };
+
+  const VkSpecializationInfo specializationInfo = {
+      .mapEntryCount = 14,
+      .pMapEntries   = specializationEntries,
+      .dataSize      = sizeof(SpecializationData),
+      .pData         = &variant.constants,
+  };
 
-    deleteShaderModule({computePipelineCreateInfo.stage});
+  // The passes of a step may each have their own workgroup size
+  std::array<SpecializationData, std::tuple_size_v<StepWorkgroupSizes>> stepSpecializationData;
+  std::array<VkSpecializationInfo, std::tuple_size_v<StepWorkgroupSizes>> stepSpecializationInfo;
+  for (size_t pass = 0; pass < stepSpecializationData.size(); ++pass) {
+    stepSpecializationData[pass]               = variant.constants;
+    stepSpecializationData[pass].workgroupSize = variant.stepWorkgroupSizes[pass];
+
+    stepSpecializationInfo[pass]       = specializationInfo;
+    stepSpecializationInfo[pass].pData = &stepSpecializationData[pass];
   }
 
-  {  // 1st pass
-    VkShaderModule compShaderModule = createShaderModule(UPDATE_GRID_COMP);
-    computePipelineCreateInfo.stage
-        = misc::pipelineShaderStageCreateInfo(compShaderModule, VK_SHADER_STAGE_COMPUTE_BIT);
+  // The shaders which access the particles have a structure-of-arrays variant
+  const bool soa = (variant.layout == ParticleLayout::SoA);
+
+  const std::vector<unsigned char>& p2gAtomic = soa ? PARTICLE_TO_GRID_ATOMIC_COMP_SOA : PARTICLE_TO_GRID_ATOMIC_COMP;
+  const std::vector<unsigned char>& p2gTiled  = soa ? PARTICLE_TO_GRID_TILED_COMP_SOA : PARTICLE_TO_GRID_TILED_COMP;
+  const std::vector<unsigned char>& p2gSerial = soa ? PARTICLE_TO_GRID_COMP_SOA : PARTICLE_TO_GRID_COMP;
 
-    if (vkCreateComputePipelines(m_device.logical(), VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr,
-                                 &m_pipelines[2])
-        != VK_SUCCESS) {
-      throw std::runtime_error("Compute Pipeline Calculate creation failed");
+  struct Stage {
+    const std::vector<unsigned char>& code;
+    const VkSpecializationInfo* specializationInfo;
+    const char* name;
+  };
+
+  // In the order of pipeline(i): the passes of a step first, with their own workgroup size
+  const Stage stages[] = {
+      {CLEAR_GRID_COMP, &stepSpecializationInfo[0], "Clear Grid"},
+      {(variant.p2gMode == P2GMode::Atomic)  ? p2gAtomic
+       : (variant.p2gMode == P2GMode::Tiled) ? p2gTiled
+                                             : p2gSerial,
+       &stepSpecializationInfo[1], "P2G"},
+      {UPDATE_GRID_COMP, &stepSpecializationInfo[2], "Update Grid"},
+      {soa ? GRID_TO_PARTICLE_COMP_SOA : GRID_TO_PARTICLE_COMP, &stepSpecializationInfo[3], "G2P"},
+      // initialisation: particles in their box, then their volume from the mass scattered by P2G
+      {soa ? INIT_PARTICLES_COMP_SOA : INIT_PARTICLES_COMP, &specializationInfo, "Init"},
+      {soa ? PARTICLE_VOLUME_COMP_SOA : PARTICLE_VOLUME_COMP, &specializationInfo, "Volume"},
+      // sparse grid: active blocks of the step
+      {soa ? MARK_BLOCKS_COMP_SOA : MARK_BLOCKS_COMP, &specializationInfo, "Blocks"},
+      // particle sort: Morton key of each particle, first sorted index of each key, particles copied in sorted order
+      // and copied back
+      {soa ? SORT_KEYS_COMP_SOA : SORT_KEYS_COMP, &specializationInfo, "Sort Keys"},
+      {SORT_SCAN_COMP, &specializationInfo, "Sort Scan"},
+      {soa ? SORT_SCATTER_COMP_SOA : SORT_SCATTER_COMP, &specializationInfo, "Sort Scatter"},
+      {soa ? SORT_GATHER_COMP_SOA : SORT_GATHER_COMP, &specializationInfo, "Sort Gather"},
+      // indirect commands of the live particles
+      {PARTICLE_COUNT_COMP, &specializationInfo, "Particle Count"},
+      // particle removal: particles out of the domain, holes before the new end of the particles, last particles moved
+      // to the holes
+      {soa ? REMOVE_MARK_COMP_SOA : REMOVE_MARK_COMP, &specializationInfo, "Remove Mark"},
+      {REMOVE_HOLES_COMP, &specializationInfo, "Remove Holes"},
+      {soa ? REMOVE_FILL_COMP_SOA : REMOVE_FILL_COMP, &specializationInfo, "Remove Fill"},
+      // particles of the emitters
+      {soa ? EMIT_PARTICLES_COMP_SOA : EMIT_PARTICLES_COMP, &specializationInfo, "Emit"},
+  };
+
+  std::vector<VkPipeline> pipelines;
+  pipelines.reserve(std::size(stages));
+
+  for (const Stage& stage : stages) {
+    VkShaderModule compShaderModule;
+    try {
+      compShaderModule = createShaderModule(stage.code);
+    } catch (...) {
+      destroyPipelines(pipelines);
+      throw;
     }
 
-    deleteShaderModule({computePipelineCreateInfo.stage});
-  }
-  {
-    // 2nd pass
-    VkShaderModule compShaderModule = createShaderModule(GRID_TO_PARTICLE_COMP);
-    computePipelineCreateInfo.stage
-        = misc::pipelineShaderStageCreateInfo(compShaderModule, VK_SHADER_STAGE_COMPUTE_BIT);
-
-    if (vkCreateComputePipelines(m_device.logical(), VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr,
-                                 &m_pipelines[3])
-        != VK_SUCCESS) {
-      throw std::runtime_error("Compute Pipeline Integrate creation failed");
+    VkComputePipelineCreateInfo computePipelineCreateInfo = {
+        .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .flags  = 0,
+        .stage  = misc::pipelineShaderStageCreateInfo(compShaderModule, VK_SHADER_STAGE_COMPUTE_BIT),
+        .layout = m_layout,
+    };
+    computePipelineCreateInfo.stage.pSpecializationInfo = stage.specializationInfo;
+
+    VkPipeline pipeline;
+    const VkResult result = vkCreateComputePipelines(m_device.logical(), m_pipelineCache.handle(), 1,
+                                                     &computePipelineCreateInfo, nullptr, &pipeline);
+
+    vkDestroyShaderModule(m_device.logical(), compShaderModule, nullptr);
+
+    // the pipelines of the variant created so far are not kept either
+    if (result != VK_SUCCESS) {
+      destroyPipelines(pipelines);
+      throw std::runtime_error(std::string("Compute Pipeline ") + stage.name + " creation failed");
     }
 
-    deleteShaderModule({computePipelineCreateInfo.stage});
+    pipelines.push_back(pipeline);
   }
-}
\ No newline at end of file
+
+  return pipelines;
+}
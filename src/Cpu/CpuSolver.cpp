@@ -0,0 +1,226 @@
+// clang-format off
+#include <Cpu/CpuSolver.hpp>
+#include <algorithm>                                     // for fill, min
+#include <utility>                                       // for swap
+// clang-format on
+
+using namespace vkm;
+
+namespace {
+
+  // The streams of the particles, one after the other in storage
+  ParticleStreams particleStreams(std::vector<float>& storage, size_t numParticles) {
+    ParticleStreams particles;
+
+    float* stream = storage.data();
+    for (float** member : {&particles.posX, &particles.posY, &particles.velX, &particles.velY, &particles.c00,
+                           &particles.c01, &particles.c10, &particles.c11, &particles.f00, &particles.f01,
+                           &particles.f10, &particles.f11, &particles.mass, &particles.volume}) {
+      *member = stream;
+      stream += numParticles;
+    }
+
+    return particles;
+  }
+
+}  // namespace
+
+CpuSolver::CpuSolver(const SimulationConfig& config, size_t numThreads, SimdLevel simdLevel)
+    : m_config(config),
+      m_parameters({
+          .deltaT         = config.dt,
+          .elastic_lambda = ELASTIC_LAMBDA,
+          .elastic_mu     = ELASTIC_MU,
+      }),
+      m_kernels(selectSimdKernels(simdLevel)),
+      m_pool(numThreads),
+      m_storage(ParticleStreams::count * config.numParticles, 0.0f),
+      m_binnedStorage(m_storage.size()),
+      m_grid(config.numCells()),
+      m_stripBegin(numStrips() + 1),
+      m_chunkStrips(((config.numParticles + grainSize - 1) / grainSize) * numStrips()) {
+  m_particles       = particleStreams(m_storage, config.numParticles);
+  m_binnedParticles = particleStreams(m_binnedStorage, config.numParticles);
+
+  initialize();
+}
+
+void CpuSolver::run(uint32_t frames) {
+  for (uint32_t i = 0; i < frames * m_config.substeps; ++i) {
+    step();
+  }
+}
+
+void CpuSolver::step() {
+  particleToGrid();
+  updateGrid();
+  gridToParticle();
+}
+
+CpuParticle CpuSolver::particle(size_t i) const {
+  return {
+      .C        = glm::mat2(m_particles.c00[i], m_particles.c01[i], m_particles.c10[i], m_particles.c11[i]),
+      .pos      = glm::vec2(m_particles.posX[i], m_particles.posY[i]),
+      .vel      = glm::vec2(m_particles.velX[i], m_particles.velY[i]),
+      .mass     = m_particles.mass[i],
+      .volume_0 = m_particles.volume[i],
+      .padding  = glm::vec2(0.0f),
+  };
+}
+
+glm::mat2 CpuSolver::deformationGradient(size_t i) const {
+  return glm::mat2(m_particles.f00[i], m_particles.f01[i], m_particles.f10[i], m_particles.f11[i]);
+}
+
+void CpuSolver::initialize() {
+  // a square box of particles, centered in the grid, like MPMStorageBuffer
+  const uint32_t side    = m_config.boxSide();
+  const float spacing    = SimulationConfig::particleSpacing;
+  const glm::vec2 center = glm::vec2(m_config.gridResolution / 2);
+  const glm::vec2 corner = center - glm::vec2(side * spacing / 2);
+
+  for (uint32_t i = 0; i < m_config.numParticles; ++i) {
+    const glm::vec2 pos = corner + glm::vec2(i / side, i % side) * spacing;
+
+    m_particles.posX[i] = pos.x;
+    m_particles.posY[i] = pos.y;
+    m_particles.mass[i] = 1.0f;
+
+    // deformation gradient initialised to the identity
+    m_particles.f00[i] = 1.0f;
+    m_particles.f11[i] = 1.0f;
+  }
+
+  // MPM course, equation 152: with F = I and no volume yet, P2G only scatters the mass
+  particleToGrid();
+
+  m_pool.parallelFor(m_config.numParticles, grainSize, [this](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i) {
+      // quadratic interpolation weights
+      const glm::vec2 pos        = glm::vec2(m_particles.posX[i], m_particles.posY[i]);
+      glm::ivec2 cell_idx        = glm::ivec2(pos);
+      glm::vec2 cell_diff        = (pos - glm::vec2(cell_idx)) - 0.5f;
+      const glm::vec2 weights[3] = {
+          0.5f * ((0.5f - cell_diff) * (0.5f - cell_diff)),
+          0.75f - (cell_diff * cell_diff),
+          0.5f * ((0.5f + cell_diff) * (0.5f + cell_diff)),
+      };
+
+      float density = 0.0f;
+      for (int gx = 0; gx < 3; ++gx) {
+        for (int gy = 0; gy < 3; ++gy) {
+          float weight   = weights[gx].x * weights[gy].y;
+          int cell_index = (cell_idx.x + gx - 1) * m_config.gridResolution + (cell_idx.y + gy - 1);
+          density += m_grid[cell_index].mass * weight;
+        }
+      }
+
+      // per-particle volume estimate has now been computed
+      m_particles.volume[i] = m_particles.mass[i] / density;
+    }
+  });
+}
+
+KernelParameters CpuSolver::kernelParameters() const {
+  return {
+      .dt             = m_parameters.deltaT,
+      .elastic_lambda = m_parameters.elastic_lambda,
+      .elastic_mu     = m_parameters.elastic_mu,
+      .gridResolution = static_cast<int>(m_config.gridResolution),
+  };
+}
+
+void CpuSolver::binParticles() {
+  const size_t strips = numStrips();
+  const size_t count  = m_config.numParticles;
+
+  auto stripOf = [this, strips](size_t i) {
+    return std::min(static_cast<size_t>(m_particles.posX[i]) / stripWidth, strips - 1);
+  };
+
+  // particles of each strip in each chunk
+  m_pool.parallelFor(count, grainSize, [this, strips, &stripOf](size_t begin, size_t end, size_t) {
+    size_t* counts = &m_chunkStrips[(begin / grainSize) * strips];
+    std::fill(counts, counts + strips, 0);
+    for (size_t i = begin; i < end; ++i) ++counts[stripOf(i)];
+  });
+
+  // strip by strip, the chunks in order keep the binning stable
+  const size_t chunks = (count + grainSize - 1) / grainSize;
+  size_t offset       = 0;
+  for (size_t strip = 0; strip < strips; ++strip) {
+    m_stripBegin[strip] = offset;
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+      const size_t particles                = m_chunkStrips[chunk * strips + strip];
+      m_chunkStrips[chunk * strips + strip] = offset;
+      offset += particles;
+    }
+  }
+  m_stripBegin[strips] = offset;
+
+  m_pool.parallelFor(count, grainSize, [this, strips, &stripOf](size_t begin, size_t end, size_t) {
+    size_t* next = &m_chunkStrips[(begin / grainSize) * strips];
+    for (size_t i = begin; i < end; ++i) {
+      const size_t j = next[stripOf(i)]++;
+      for (size_t stream = 0; stream < ParticleStreams::count; ++stream) {
+        m_binnedStorage[stream * m_config.numParticles + j] = m_storage[stream * m_config.numParticles + i];
+      }
+    }
+  });
+
+  // the streams keep pointing to their storage, both are swapped
+  std::swap(m_storage, m_binnedStorage);
+  std::swap(m_particles, m_binnedParticles);
+}
+
+void CpuSolver::particleToGrid() {
+  const KernelParameters parameters = kernelParameters();
+
+  binParticles();
+
+  m_pool.parallelFor(m_grid.size(), grainSize, [this](size_t begin, size_t end, size_t) {
+    std::fill(m_grid.begin() + begin, m_grid.begin() + end, Cell{});
+  });
+
+  // the even strips, then the odd ones: the strips of a colour are two strips apart, so their stencils never overlap
+  const size_t strips = numStrips();
+  for (size_t colour = 0; colour < 2; ++colour) {
+    m_pool.parallelFor((strips - colour + 1) / 2, 1, [this, &parameters, colour](size_t begin, size_t end, size_t) {
+      for (size_t i = begin; i < end; ++i) {
+        const size_t strip = 2 * i + colour;
+        m_kernels.particleToGrid(m_particles, m_stripBegin[strip], m_stripBegin[strip + 1], parameters,
+                                 m_grid.data());
+      }
+    });
+  }
+}
+
+void CpuSolver::updateGrid() {
+  const float dt = m_parameters.deltaT;
+  const int res  = static_cast<int>(m_config.gridResolution);
+
+  m_pool.parallelFor(m_grid.size(), grainSize, [this, dt, res](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i) {
+      Cell& cell = m_grid[i];
+      if (cell.mass <= 0) continue;
+
+      // convert momentum to velocity, apply gravity
+      cell.vel /= cell.mass;
+      cell.vel += dt * glm::vec2(0.0f, m_config.gravity);
+
+      // 'slip' boundary conditions
+      int x = static_cast<int>(i) / res;
+      int y = static_cast<int>(i) % res;
+      if (x < 2 || x > res - 3) cell.vel.x = 0;
+      if (y < 2 || y > res - 3) cell.vel.y = 0;
+    }
+  });
+}
+
+void CpuSolver::gridToParticle() {
+  const KernelParameters parameters = kernelParameters();
+
+  m_pool.parallelFor(m_config.numParticles, grainSize, [this, &parameters](size_t begin, size_t end, size_t) {
+    m_kernels.gridToParticle(m_particles, begin, end, parameters, m_grid.data());
+  });
+}
@@ -0,0 +1,90 @@
+// clang-format off
+#include <Cpu/SimdKernels.hpp>
+#include <Cpu/SimdKernelsImpl.hpp>                       // for MpmKernels, ScalarVec
+#include <stdexcept>                                     // for runtime_error
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>                                      // for __cpuidex, _xgetbv
+#endif
+// clang-format on
+
+using namespace vkm;
+
+namespace {
+
+  const SimdKernels kernels = {
+      .name           = "scalar",
+      .particleToGrid = &MpmKernels<ScalarVec>::particleToGrid,
+      .gridToParticle = &MpmKernels<ScalarVec>::gridToParticle,
+  };
+
+  bool cpuSupports(SimdLevel level) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    switch (level) {
+      case SimdLevel::SSE:
+        return __builtin_cpu_supports("sse2");
+      case SimdLevel::AVX2:
+        return __builtin_cpu_supports("avx2");
+      case SimdLevel::AVX512:
+        return __builtin_cpu_supports("avx512f");
+      default:
+        return true;
+    }
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuidex(info, 1, 0);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool sse2    = (info[3] & (1 << 26)) != 0;
+
+    // the OS must save the wide registers on context switches
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+
+    __cpuidex(info, 7, 0);
+    switch (level) {
+      case SimdLevel::SSE:
+        return sse2;
+      case SimdLevel::AVX2:
+        return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+      case SimdLevel::AVX512:
+        return (xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)) != 0;
+      default:
+        return true;
+    }
+#else
+    return level == SimdLevel::Scalar || level == SimdLevel::Auto;
+#endif
+  }
+
+  const SimdKernels* kernelsOf(SimdLevel level) {
+    switch (level) {
+      case SimdLevel::SSE:
+        return sseKernels();
+      case SimdLevel::AVX2:
+        return avx2Kernels();
+      case SimdLevel::AVX512:
+        return avx512Kernels();
+      default:
+        return scalarKernels();
+    }
+  }
+
+}  // namespace
+
+const SimdKernels* vkm::scalarKernels() { return &kernels; }
+
+const SimdKernels& vkm::selectSimdKernels(SimdLevel level) {
+  if (level != SimdLevel::Auto) {
+    const SimdKernels* selected = kernelsOf(level);
+    if (selected == nullptr || !cpuSupports(level)) {
+      throw std::runtime_error("the requested SIMD instruction set is not available on this build or CPU!");
+    }
+    return *selected;
+  }
+
+  // widest first
+  for (SimdLevel candidate : {SimdLevel::AVX512, SimdLevel::AVX2, SimdLevel::SSE}) {
+    const SimdKernels* selected = kernelsOf(candidate);
+    if (selected != nullptr && cpuSupports(candidate)) return *selected;
+  }
+
+  return kernels;
+}
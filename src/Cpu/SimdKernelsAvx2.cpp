@@ -0,0 +1,64 @@
+// clang-format off
+#include <Cpu/SimdKernels.hpp>
+#if defined(__AVX2__)
+#include <Cpu/SimdKernelsImpl.hpp>                       // for MpmKernels
+#include <immintrin.h>                                   // for __m256, _mm256_add_ps, ...
+#endif
+// clang-format on
+
+using namespace vkm;
+
+// Compiled with the AVX2 flags by CMake, only called when the CPU supports them
+
+#if defined(__AVX2__)
+
+namespace {
+
+  struct Avx2Vec {
+    using F = __m256;
+
+    static constexpr size_t width = 8;
+
+    static inline F load(const float* p) { return _mm256_loadu_ps(p); }
+    static inline void store(float* p, F a) { _mm256_storeu_ps(p, a); }
+    static inline F set(float a) { return _mm256_set1_ps(a); }
+
+    static inline F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static inline F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static inline F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static inline F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static inline F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static inline F max(F a, F b) { return _mm256_max_ps(a, b); }
+
+    static inline F trunc(F a) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a)); }
+
+    static inline F exponent(F a) {
+      const __m256i bits = _mm256_srli_epi32(_mm256_castps_si256(a), 23);
+      return _mm256_cvtepi32_ps(
+          _mm256_sub_epi32(_mm256_and_si256(bits, _mm256_set1_epi32(0xff)), _mm256_set1_epi32(127)));
+    }
+    static inline F mantissa(F a) {
+      const __m256i bits = _mm256_and_si256(_mm256_castps_si256(a), _mm256_set1_epi32(0x007fffff));
+      return _mm256_castsi256_ps(_mm256_or_si256(bits, _mm256_set1_epi32(0x3f800000)));
+    }
+
+    static inline F gather(const float* base, const int32_t* indices) {
+      return _mm256_i32gather_ps(base, _mm256_load_si256(reinterpret_cast<const __m256i*>(indices)), 4);
+    }
+  };
+
+  const SimdKernels kernels = {
+      .name           = "avx2",
+      .particleToGrid = &MpmKernels<Avx2Vec>::particleToGrid,
+      .gridToParticle = &MpmKernels<Avx2Vec>::gridToParticle,
+  };
+
+}  // namespace
+
+const SimdKernels* vkm::avx2Kernels() { return &kernels; }
+
+#else
+
+const SimdKernels* vkm::avx2Kernels() { return nullptr; }
+
+#endif
@@ -0,0 +1,70 @@
+// clang-format off
+#include <Cpu/SimdKernels.hpp>
+#if defined(__AVX512F__)
+#include <Cpu/SimdKernelsImpl.hpp>                       // for MpmKernels
+#include <immintrin.h>                                   // for __m512, _mm512_add_ps, ...
+#endif
+// clang-format on
+
+using namespace vkm;
+
+// Compiled with the AVX-512 flags by CMake, only called when the CPU supports them
+
+#if defined(__AVX512F__)
+
+// GCC 12 reports the undefined source register the unmasked intrinsics pass to their builtin as used uninitialized
+// (GCC bug 105593), an error with the warnings of the build
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+namespace {
+
+  struct Avx512Vec {
+    using F = __m512;
+
+    static constexpr size_t width = 16;
+
+    static inline F load(const float* p) { return _mm512_loadu_ps(p); }
+    static inline void store(float* p, F a) { _mm512_storeu_ps(p, a); }
+    static inline F set(float a) { return _mm512_set1_ps(a); }
+
+    static inline F add(F a, F b) { return _mm512_add_ps(a, b); }
+    static inline F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+    static inline F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+    static inline F div(F a, F b) { return _mm512_div_ps(a, b); }
+    static inline F min(F a, F b) { return _mm512_min_ps(a, b); }
+    static inline F max(F a, F b) { return _mm512_max_ps(a, b); }
+
+    static inline F trunc(F a) { return _mm512_cvtepi32_ps(_mm512_cvttps_epi32(a)); }
+
+    static inline F exponent(F a) {
+      const __m512i bits = _mm512_srli_epi32(_mm512_castps_si512(a), 23);
+      return _mm512_cvtepi32_ps(
+          _mm512_sub_epi32(_mm512_and_si512(bits, _mm512_set1_epi32(0xff)), _mm512_set1_epi32(127)));
+    }
+    static inline F mantissa(F a) {
+      const __m512i bits = _mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x007fffff));
+      return _mm512_castsi512_ps(_mm512_or_si512(bits, _mm512_set1_epi32(0x3f800000)));
+    }
+
+    static inline F gather(const float* base, const int32_t* indices) {
+      return _mm512_i32gather_ps(_mm512_load_si512(indices), base, 4);
+    }
+  };
+
+  const SimdKernels kernels = {
+      .name           = "avx512",
+      .particleToGrid = &MpmKernels<Avx512Vec>::particleToGrid,
+      .gridToParticle = &MpmKernels<Avx512Vec>::gridToParticle,
+  };
+
+}  // namespace
+
+const SimdKernels* vkm::avx512Kernels() { return &kernels; }
+
+#else
+
+const SimdKernels* vkm::avx512Kernels() { return nullptr; }
+
+#endif
@@ -0,0 +1,62 @@
+// clang-format off
+#include <Cpu/SimdKernels.hpp>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <Cpu/SimdKernelsImpl.hpp>                       // for MpmKernels
+#include <emmintrin.h>                                   // for __m128, _mm_add_ps, ...
+#endif
+// clang-format on
+
+using namespace vkm;
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+namespace {
+
+  struct SseVec {
+    using F = __m128;
+
+    static constexpr size_t width = 4;
+
+    static inline F load(const float* p) { return _mm_loadu_ps(p); }
+    static inline void store(float* p, F a) { _mm_storeu_ps(p, a); }
+    static inline F set(float a) { return _mm_set1_ps(a); }
+
+    static inline F add(F a, F b) { return _mm_add_ps(a, b); }
+    static inline F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static inline F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static inline F div(F a, F b) { return _mm_div_ps(a, b); }
+    static inline F min(F a, F b) { return _mm_min_ps(a, b); }
+    static inline F max(F a, F b) { return _mm_max_ps(a, b); }
+
+    static inline F trunc(F a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+
+    static inline F exponent(F a) {
+      const __m128i bits = _mm_srli_epi32(_mm_castps_si128(a), 23);
+      return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(bits, _mm_set1_epi32(0xff)), _mm_set1_epi32(127)));
+    }
+    static inline F mantissa(F a) {
+      const __m128i bits = _mm_and_si128(_mm_castps_si128(a), _mm_set1_epi32(0x007fffff));
+      return _mm_castsi128_ps(_mm_or_si128(bits, _mm_set1_epi32(0x3f800000)));
+    }
+
+    // no gather instruction before AVX2
+    static inline F gather(const float* base, const int32_t* indices) {
+      return _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]);
+    }
+  };
+
+  const SimdKernels kernels = {
+      .name           = "sse",
+      .particleToGrid = &MpmKernels<SseVec>::particleToGrid,
+      .gridToParticle = &MpmKernels<SseVec>::gridToParticle,
+  };
+
+}  // namespace
+
+const SimdKernels* vkm::sseKernels() { return &kernels; }
+
+#else
+
+const SimdKernels* vkm::sseKernels() { return nullptr; }
+
+#endif
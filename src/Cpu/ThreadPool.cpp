@@ -0,0 +1,131 @@
+// clang-format off
+#include <Cpu/ThreadPool.hpp>
+#include <algorithm>                                     // for max, min
+#include <exception>                                     // for exception_ptr, current_exception, rethrow_exception
+#include <utility>                                       // for move
+// clang-format on
+
+using namespace vkm;
+
+ThreadPool::ThreadPool(size_t numThreads) : m_pending(0), m_stop(false) {
+  // hardware_concurrency may return 0, and the calling thread takes one core
+  numThreads = std::max<size_t>(numThreads, 1) - 1;
+
+  for (size_t i = 0; i < numThreads + 1; ++i) {
+    m_queues.push_back(std::make_unique<Queue>());
+  }
+
+  m_threads.reserve(numThreads);
+  for (size_t i = 0; i < numThreads; ++i) {
+    m_threads.emplace_back(&ThreadPool::worker, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+
+  for (std::thread& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const RangeTask& task) {
+  if (count == 0) return;
+
+  grain                   = std::max<size_t>(grain, 1);
+  const size_t numChunks  = (count + grain - 1) / grain;
+  const size_t callerSlot = m_threads.size();
+
+  if (numChunks == 1 || m_threads.empty()) {
+    for (size_t begin = 0; begin < count; begin += grain) {
+      task(begin, std::min(begin + grain, count), callerSlot);
+    }
+    return;
+  }
+
+  std::atomic<size_t> remaining(numChunks);
+
+  // the first exception thrown by a chunk, rethrown once every chunk is done
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  // deal the chunks round-robin, idle threads steal the leftovers
+  for (size_t chunk = 0; chunk < numChunks; ++chunk) {
+    const size_t begin = chunk * grain;
+    const size_t end   = std::min(begin + grain, count);
+
+    push(chunk % m_queues.size(), [&task, &remaining, &errorMutex, &error, begin, end](size_t slot) {
+      try {
+        task(begin, end, slot);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) error = std::current_exception();
+      }
+      remaining.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  // the calling thread works too instead of blocking
+  while (remaining.load(std::memory_order_acquire) > 0) {
+    if (!tryRun(callerSlot)) std::this_thread::yield();
+  }
+
+  if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::worker(size_t slot) {
+  while (true) {
+    if (tryRun(slot)) continue;
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_wake.wait(lock, [this]() { return m_stop || m_pending > 0; });
+    if (m_stop) return;
+  }
+}
+
+void ThreadPool::push(size_t slot, Task task) {
+  // count the task before it is visible, so a thread running it can't take m_pending below zero
+  m_pending.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(m_queues[slot]->mutex);
+    m_queues[slot]->tasks.push_back(std::move(task));
+  }
+
+  // take the lock so a worker can't miss the notification between its check and its wait
+  { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+  m_wake.notify_one();
+}
+
+bool ThreadPool::tryRun(size_t slot) {
+  Task task;
+
+  // own queue first, oldest task
+  {
+    Queue& queue = *m_queues[slot];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+  }
+
+  // then steal the newest task of another thread
+  for (size_t i = 1; !task && i < m_queues.size(); ++i) {
+    Queue& queue = *m_queues[(slot + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+  }
+
+  if (!task) return false;
+
+  m_pending.fetch_sub(1);
+  task(slot);
+  return true;
+}
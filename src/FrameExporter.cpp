@@ -0,0 +1,247 @@
+// clang-format off
+#include <FrameExporter.hpp>
+#include <Compute/MPMStorageBuffer.hpp>                  // for MPMStorageBuffer
+#include <struct/Particle.hpp>                           // for Particle
+#include <struct/ParticleCounter.hpp>                    // for ParticleCounter
+#include <algorithm>                                     // for any_of, clamp, max, min
+#include <cmath>                                         // for abs, round
+#include <cstddef>                                       // for offsetof
+#include <cstring>                                       // for memcpy
+#include <stdexcept>                                     // for runtime_error
+#include <poike/poike.hpp>
+// clang-format on
+
+using namespace vkm;
+using namespace poike;
+
+FrameExporter::Slot::Slot(const Device& device, VkDeviceSize size)
+    : buffer(device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {}
+
+FrameExporter::FrameExporter(const Device& device,
+                             const CommandPool& commandPool,
+                             const ComputeCommandBuffer& commandBuffer,
+                             const SimulationConfig& config,
+                             const std::string& filename,
+                             uint32_t interval,
+                             FrameEncoding encoding)
+    : m_device(device),
+      m_commandPool(commandPool),
+      m_config(config),
+      m_interval(interval),
+      m_encoding(encoding),
+      m_file(filename, std::ios::binary | std::ios::trunc) {
+  if (m_interval == 0) {
+    throw std::runtime_error("the frames are exported every 1 frame at least!");
+  }
+
+  FrameFileHeader header = {
+      .version        = version,
+      .encoding       = static_cast<uint32_t>(m_encoding),
+      .gridResolution = m_config.gridResolution,
+      .interval       = m_interval,
+      .instances      = m_config.instances,
+  };
+  std::memcpy(header.magic, magic, sizeof(magic));
+
+  if (!m_file.write(reinterpret_cast<const char*>(&header), sizeof(header))) {
+    throw std::runtime_error("failed to open frame file: " + filename);
+  }
+
+  // The counter, then the positions and velocities up to the capacity
+  const std::vector<MPMStorageBuffer::ParticleStream> streams = MPMStorageBuffer::exportStreams(m_config);
+  VkDeviceSize size                                           = sizeof(ParticleCounter);
+  for (const MPMStorageBuffer::ParticleStream& stream : streams) {
+    size += m_config.particleCapacity() * stream.stride;
+  }
+
+  const VkCommandBufferAllocateInfo allocInfo = {
+      .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool        = m_commandPool.handle(),
+      .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+
+  const VkCommandBufferBeginInfo beginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+  };
+
+  const VkFenceCreateInfo fenceInfo = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+  };
+
+  // The buffers stay mapped and their copies recorded, a capture is a single submission
+  for (size_t i = 0; i < ringSize; ++i) {
+    Slot& slot = m_slots.emplace_back(m_device, size);
+
+    void* data;
+    vkMapMemory(m_device.logical(), slot.buffer.memory(), 0, size, 0, &data);
+    slot.data = static_cast<const char*>(data);
+
+    if (vkAllocateCommandBuffers(m_device.logical(), &allocInfo, &slot.command) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+    if (vkBeginCommandBuffer(slot.command, &beginInfo) != VK_SUCCESS) {
+      throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    commandBuffer.recordStateCopy(slot.command, slot.buffer, streams);
+    if (vkEndCommandBuffer(slot.command) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record command buffer!");
+    }
+
+    if (vkCreateFence(m_device.logical(), &fenceInfo, nullptr, &slot.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create fence!");
+    }
+  }
+
+  m_writer = std::thread(&FrameExporter::writeFrames, this);
+}
+
+FrameExporter::~FrameExporter() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_captured.notify_one();
+  m_writer.join();
+
+  for (Slot& slot : m_slots) {
+    vkUnmapMemory(m_device.logical(), slot.buffer.memory());
+    vkFreeCommandBuffers(m_device.logical(), m_commandPool.handle(), 1, &slot.command);
+    vkDestroyFence(m_device.logical(), slot.fence, nullptr);
+  }
+}
+
+void FrameExporter::capture(uint64_t frame) {
+  if (frame % m_interval != 0) return;
+
+  // The writer is behind by the whole ring
+  Slot& slot = m_slots[m_next];
+  if (slot.queued) {
+    ++m_dropped;
+    return;
+  }
+
+  slot.frame  = frame;
+  slot.queued = true;
+
+  const VkSubmitInfo submitInfo = {
+      .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .commandBufferCount = 1,
+      .pCommandBuffers    = &slot.command,
+  };
+
+  if (vkQueueSubmit(m_device.computeQueue(), 1, &submitInfo, slot.fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit frame export command buffer!");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.push_back(m_next);
+  }
+  m_captured.notify_one();
+
+  m_next = (m_next + 1) % m_slots.size();
+}
+
+bool FrameExporter::writing() const {
+  return std::any_of(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.queued.load(); });
+}
+
+void FrameExporter::flush() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_chunkWritten.wait(lock, [this]() { return !writing(); });
+}
+
+void FrameExporter::writeFrames() {
+  while (true) {
+    size_t index;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_captured.wait(lock, [this]() { return m_stopping || !m_pending.empty(); });
+      // stopped once every capture is written
+      if (m_pending.empty()) return;
+
+      index = m_pending.front();
+      m_pending.pop_front();
+    }
+
+    Slot& slot = m_slots[index];
+    vkWaitForFences(m_device.logical(), 1, &slot.fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(m_device.logical(), 1, &slot.fence);
+
+    // the next chunks would be misread after a truncated one
+    if (!m_failed) {
+      if (writeChunk(slot)) {
+        ++m_written;
+      } else {
+        m_failed = true;
+      }
+    }
+
+    // under the lock so that flush can't miss it between its check and its wait
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      slot.queued = false;
+    }
+    m_chunkWritten.notify_all();
+  }
+}
+
+bool FrameExporter::writeChunk(const Slot& slot) {
+  ParticleCounter counter;
+  std::memcpy(&counter, slot.data, sizeof(counter));
+
+  const uint32_t capacity = m_config.particleCapacity();
+  const uint32_t count    = std::min(counter.count, capacity);
+
+  // The fields of each Particle, or the position and velocity streams one after the other
+  const char* particles  = slot.data + sizeof(ParticleCounter);
+  const bool aos         = m_config.layout == ParticleLayout::AoS;
+  const size_t stride    = aos ? sizeof(Particle) : sizeof(glm::vec2);
+  const char* positions  = aos ? particles + offsetof(Particle, pos) : particles;
+  const char* velocities = aos ? particles + offsetof(Particle, vel) : particles + capacity * sizeof(glm::vec2);
+
+  m_positions.resize(count);
+  m_velocities.resize(count);
+
+  float velocityScale = 0.0f;
+  for (uint32_t i = 0; i < count; ++i) {
+    std::memcpy(&m_positions[i], positions + i * stride, sizeof(glm::vec2));
+    std::memcpy(&m_velocities[i], velocities + i * stride, sizeof(glm::vec2));
+    velocityScale = std::max({velocityScale, std::abs(m_velocities[i].x), std::abs(m_velocities[i].y)});
+  }
+
+  const FrameChunkHeader header = {
+      .frame         = slot.frame,
+      .count         = count,
+      .velocityScale = velocityScale,
+  };
+  m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  if (m_encoding == FrameEncoding::Float) {
+    m_file.write(reinterpret_cast<const char*>(m_positions.data()), count * sizeof(glm::vec2));
+    m_file.write(reinterpret_cast<const char*>(m_velocities.data()), count * sizeof(glm::vec2));
+    return static_cast<bool>(m_file.flush());
+  }
+
+  // Half the size: 1/65535 of the grid for the positions, 1/32767 of the scale for the velocities
+  const float cellScale     = 65535.0f / m_config.gridResolution;
+  const float velocityRange = velocityScale > 0.0f ? 32767.0f / velocityScale : 0.0f;
+
+  m_quantizedPositions.resize(2 * count);
+  m_quantizedVelocities.resize(2 * count);
+  for (uint32_t i = 0; i < count; ++i) {
+    for (int axis = 0; axis < 2; ++axis) {
+      const float position = std::clamp(m_positions[i][axis] * cellScale, 0.0f, 65535.0f);
+      const float velocity = m_velocities[i][axis] * velocityRange;
+
+      m_quantizedPositions[2 * i + axis]  = static_cast<uint16_t>(std::round(position));
+      m_quantizedVelocities[2 * i + axis] = static_cast<int16_t>(std::round(velocity));
+    }
+  }
+
+  m_file.write(reinterpret_cast<const char*>(m_quantizedPositions.data()), 2 * count * sizeof(uint16_t));
+  m_file.write(reinterpret_cast<const char*>(m_quantizedVelocities.data()), 2 * count * sizeof(int16_t));
+  return static_cast<bool>(m_file.flush());
+}
@@ -0,0 +1,60 @@
+// clang-format off
+#include <FrameScheduler.hpp>
+#include <algorithm>                                     // for max
+#include <stdexcept>                                     // for runtime_error
+#include <poike/poike.hpp>
+// clang-format on
+
+using namespace vkm;
+using namespace poike;
+
+FrameScheduler::Timeline::Timeline(const Device& device, uint32_t size) : m_device(device), m_fences(size) {
+  // Unsignaled, a fence is only waited once it was submitted
+  const VkFenceCreateInfo fenceInfo = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+  };
+
+  for (VkFence& fence : m_fences) {
+    if (vkCreateFence(m_device.logical(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create fence!");
+    }
+  }
+}
+
+FrameScheduler::Timeline::~Timeline() {
+  wait(next);
+
+  for (VkFence& fence : m_fences) {
+    vkDestroyFence(m_device.logical(), fence, nullptr);
+  }
+}
+
+void FrameScheduler::Timeline::waitSlot() {
+  // The fence of the next submission was signaled by the one m_fences.size() before it
+  if (next >= m_fences.size()) wait(next - m_fences.size() + 1);
+}
+
+VkFence FrameScheduler::Timeline::fence() {
+  waitSlot();
+
+  VkFence fence = m_fences[next % m_fences.size()];
+  vkResetFences(m_device.logical(), 1, &fence);
+
+  return fence;
+}
+
+void FrameScheduler::Timeline::submitted() { ++next; }
+
+void FrameScheduler::Timeline::wait(uint64_t value) {
+  if (value > next) {
+    throw std::runtime_error("failed to wait for a submission which wasn't made!");
+  }
+
+  // The older submissions were waited through a later one of the same queue
+  const uint64_t first = std::max(completed, next - std::min<uint64_t>(next, m_fences.size()));
+  for (uint64_t i = first; i < value; ++i) {
+    vkWaitForFences(m_device.logical(), 1, &m_fences[i % m_fences.size()], VK_TRUE, UINT64_MAX);
+  }
+
+  completed = std::max(completed, value);
+}
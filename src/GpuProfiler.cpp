@@ -0,0 +1,214 @@
+// clang-format off
+#include <GpuProfiler.hpp>
+#include <algorithm>                                     // for sort, min, max
+#include <numeric>                                       // for accumulate
+#include <optional>                                      // for optional
+#include <stdexcept>                                     // for runtime_error
+#include <poike/poike.hpp>
+// clang-format on
+
+using namespace vkm;
+using namespace poike;
+
+GpuProfiler::GpuProfiler(const Device& device, uint32_t substeps, uint32_t numImages)
+    : m_device(device), m_substeps(substeps), m_numImages(numImages) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(m_device.physical(), &properties);
+  m_period = properties.limits.timestampPeriod;
+
+  uint32_t count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(m_device.physical(), &count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(count);
+  vkGetPhysicalDeviceQueueFamilyProperties(m_device.physical(), &count, families.data());
+
+  // Both queues write timestamps, keep the bits valid on each
+  const std::optional<uint32_t>& graphicsFamily = m_device.queueFamilyIndices().graphicsFamily;
+  const std::optional<uint32_t>& computeFamily  = m_device.queueFamilyIndices().computeFamily;
+
+  uint32_t validBits = families[computeFamily.value()].timestampValidBits;
+  if (numImages > 0 && graphicsFamily.has_value()) {
+    validBits = std::min(validBits, families[graphicsFamily.value()].timestampValidBits);
+  }
+
+  m_validMask = (validBits >= 64) ? ~uint64_t(0) : ((uint64_t(1) << validBits) - 1);
+
+  if (validBits > 0) createQueryPool();
+}
+
+GpuProfiler::~GpuProfiler() { destroyQueryPool(); }
+
+void GpuProfiler::recreate(uint32_t substeps, uint32_t numImages) {
+  if (!enabled()) return;
+
+  destroyQueryPool();
+  m_substeps  = substeps;
+  m_numImages = numImages;
+  createQueryPool();
+}
+
+void GpuProfiler::createQueryPool() {
+  m_lastCompute = 0;
+  m_lastGraphics.assign(m_numImages, 0);
+
+  const VkQueryPoolCreateInfo queryPoolInfo = {
+      .sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .queryType  = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = numComputeQueries() + 2 * m_numImages,
+  };
+
+  if (vkCreateQueryPool(m_device.logical(), &queryPoolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timestamp query pool!");
+  }
+}
+
+void GpuProfiler::destroyQueryPool() {
+  if (m_queryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(m_device.logical(), m_queryPool, nullptr);
+    m_queryPool = VK_NULL_HANDLE;
+  }
+}
+
+void GpuProfiler::beginCompute(VkCommandBuffer cmdBuffer) const {
+  if (!enabled()) return;
+
+  // once the dispatches recorded before it are done, like the end of each pass
+  vkCmdResetQueryPool(cmdBuffer, m_queryPool, 0, numComputeQueries());
+  vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, m_queryPool, 0);
+}
+
+void GpuProfiler::endComputePass(VkCommandBuffer cmdBuffer, uint32_t substep, GpuPass pass) const {
+  if (!enabled()) return;
+
+  vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, m_queryPool, computeQuery(substep, pass));
+}
+
+void GpuProfiler::beginGraphics(VkCommandBuffer cmdBuffer, uint32_t image) const {
+  if (!enabled()) return;
+
+  // outside of the render pass
+  vkCmdResetQueryPool(cmdBuffer, m_queryPool, graphicsQuery(image), 2);
+  vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, graphicsQuery(image));
+}
+
+void GpuProfiler::endGraphics(VkCommandBuffer cmdBuffer, uint32_t image) const {
+  if (!enabled()) return;
+
+  vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, graphicsQuery(image) + 1);
+}
+
+void GpuProfiler::collectCompute() {
+  if (!enabled()) return;
+
+  std::vector<uint64_t> timestamps(numComputeQueries());
+
+  // No wait flag: VK_NOT_READY while the last submission is still running, the frame is just not sampled
+  if (vkGetQueryPoolResults(m_device.logical(), m_queryPool, 0, numComputeQueries(),
+                            timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+                            VK_QUERY_RESULT_64_BIT)
+      != VK_SUCCESS) {
+    return;
+  }
+  if (timestamps[0] == m_lastCompute) return;
+  m_lastCompute = timestamps[0];
+
+  // Every pass starts when the previous one ends, summed over the substeps
+  std::array<uint64_t, 4> ticks = {};
+  uint64_t previous             = timestamps[0] & m_validMask;
+  for (uint32_t substep = 0; substep < m_substeps; ++substep) {
+    for (uint32_t pass = 0; pass < 4; ++pass) {
+      const uint64_t current = timestamps[computeQuery(substep, static_cast<GpuPass>(pass))] & m_validMask;
+      ticks[pass] += (current - previous) & m_validMask;
+      previous = current;
+    }
+  }
+
+  for (uint32_t pass = 0; pass < 4; ++pass) {
+    push(static_cast<GpuPass>(pass), ticks[pass] * m_period * 1e-6);
+  }
+}
+
+void GpuProfiler::collectGraphics(uint32_t image) {
+  if (!enabled()) return;
+
+  uint64_t timestamps[2];
+  if (vkGetQueryPoolResults(m_device.logical(), m_queryPool, graphicsQuery(image), 2, sizeof(timestamps), timestamps,
+                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT)
+      != VK_SUCCESS) {
+    return;
+  }
+  if (timestamps[0] == m_lastGraphics[image]) return;
+  m_lastGraphics[image] = timestamps[0];
+
+  push(GpuPass::Graphics, ((timestamps[1] - timestamps[0]) & m_validMask) * m_period * 1e-6);
+}
+
+void GpuProfiler::push(GpuPass pass, double milliseconds) {
+  std::deque<double>& history = m_history[static_cast<size_t>(pass)];
+
+  history.push_back(milliseconds);
+  if (history.size() > historySize) history.pop_front();
+}
+
+void GpuProfiler::clearHistory() {
+  for (std::deque<double>& history : m_history) {
+    history.clear();
+  }
+}
+
+GpuProfiler::Stats GpuProfiler::stats(GpuPass pass) const {
+  const std::deque<double>& history = m_history[static_cast<size_t>(pass)];
+  if (history.empty()) return {0.0, 0.0, 0.0, 0};
+
+  std::vector<double> sorted(history.begin(), history.end());
+  std::sort(sorted.begin(), sorted.end());
+
+  const size_t p99 = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * 0.99));
+
+  return {
+      .min     = sorted.front(),
+      .avg     = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size(),
+      .p99     = sorted[p99],
+      .samples = sorted.size(),
+  };
+}
+
+const char* GpuProfiler::name(GpuPass pass) {
+  switch (pass) {
+    case GpuPass::ClearGrid:
+      return "clear_grid";
+    case GpuPass::P2G:
+      return "p2g";
+    case GpuPass::UpdateGrid:
+      return "update_grid";
+    case GpuPass::G2P:
+      return "g2p";
+    case GpuPass::Graphics:
+      return "graphics";
+    default:
+      return "unknown";
+  }
+}
+
+void GpuProfiler::writeCsv(std::ostream& os) const {
+  os << "pass,sample,milliseconds\n";
+  for (size_t pass = 0; pass < numPasses; ++pass) {
+    for (size_t i = 0; i < m_history[pass].size(); ++i) {
+      os << name(static_cast<GpuPass>(pass)) << "," << i << "," << m_history[pass][i] << "\n";
+    }
+  }
+}
+
+void GpuProfiler::writeJson(std::ostream& os) const {
+  os << "{\n";
+  for (size_t pass = 0; pass < numPasses; ++pass) {
+    const Stats s = stats(static_cast<GpuPass>(pass));
+
+    os << "  \"" << name(static_cast<GpuPass>(pass)) << "\": {\"min\": " << s.min << ", \"avg\": " << s.avg
+       << ", \"p99\": " << s.p99 << ", \"samples\": [";
+    for (size_t i = 0; i < m_history[pass].size(); ++i) {
+      os << (i > 0 ? ", " : "") << m_history[pass][i];
+    }
+    os << "]}" << (pass + 1 < numPasses ? "," : "") << "\n";
+  }
+  os << "}\n";
+}
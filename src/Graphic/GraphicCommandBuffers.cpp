@@ -5,13 +5,15 @@
 #include <stdexcept>                        // for runtime_error
 #include <poike/poike.hpp>
 #include <Compute/MPMStorageBuffer.hpp>
+#include <Graphic/ParticleRenderBuffers.hpp>
 // clang-format on
 
 using namespace vkm;
 using namespace poike;
 
 void GraphicCommandBuffers::createCommandBuffers() {
-  m_commandBuffers.resize(m_renderPass.size());
+  // One per swap chain image and render buffer, see command()
+  m_commandBuffers.resize(m_renderPass.size() * m_buffers.size());
 
   const VkCommandBufferAllocateInfo allocInfo = {
       .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -44,14 +46,18 @@ void GraphicCommandBuffers::createCommandBuffers() {
       };
 
   for (size_t i = 0; i < m_commandBuffers.size(); ++i) {
+    const uint32_t image = static_cast<uint32_t>(i / m_buffers.size());
+
     // Set target frame buffer
-    renderPassBeginInfo.framebuffer = m_renderPass.frameBuffer(i);
+    renderPassBeginInfo.framebuffer = m_renderPass.frameBuffer(image);
 
     if (vkBeginCommandBuffer(m_commandBuffers.at(i), &cmdBufInfo) != VK_SUCCESS) {
       throw std::runtime_error("failed to begin recording command buffer!");
     }
 
-    const StorageBuffer* storageBuffer = dynamic_cast<const StorageBuffer*>(m_buffers[0]);
+    if (m_profiler) m_profiler->beginGraphics(m_commandBuffers[i], image);
+
+    const StorageBuffer* storageBuffer = dynamic_cast<const StorageBuffer*>(m_buffers[i % m_buffers.size()]);
 
     const std::optional<uint32_t>& graphicsFamily = m_device.queueFamilyIndices().graphicsFamily;
     const std::optional<uint32_t>& computeFamily  = m_device.queueFamilyIndices().computeFamily;
@@ -61,7 +67,7 @@ void GraphicCommandBuffers::createCommandBuffers() {
       const VkBufferMemoryBarrier buffer_barrier = {
           .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
           .srcAccessMask       = 0,
-          .dstAccessMask       = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+          .dstAccessMask       = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
           .srcQueueFamilyIndex = computeFamily.value(),
           .dstQueueFamilyIndex = graphicsFamily.value(),
           .buffer              = storageBuffer->buffer(),
@@ -69,8 +75,9 @@ void GraphicCommandBuffers::createCommandBuffers() {
           .size                = storageBuffer->size(),
       };
 
-      vkCmdPipelineBarrier(m_commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                           VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &buffer_barrier, 0, nullptr);
+      vkCmdPipelineBarrier(m_commandBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1,
+                           &buffer_barrier, 0, nullptr);
     }
 
     // Draw the particle system using the update vertex buffer
@@ -78,30 +85,18 @@ void GraphicCommandBuffers::createCommandBuffers() {
 
     vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline.pipeline());
     vkCmdBindDescriptorSets(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline.layout(), 0, 1,
-                            &m_descriptorSets.descriptor(i), 0, nullptr);
+                            &m_descriptorSets.descriptor(image), 0, nullptr);
 
-    VkDeviceSize offsets[1] = {0};
+    // The render buffer starts with the draw command of the live particles, then their vertices
+    VkDeviceSize offsets[1] = {ParticleRenderBuffers::drawCommandSize};
     vkCmdBindVertexBuffers(m_commandBuffers[i], 0, 1, &(storageBuffer->buffer()), offsets);
-    vkCmdDraw(m_commandBuffers[i], NUM_PARTICLE, 1, 0, 0);
+    vkCmdDrawIndirect(m_commandBuffers[i], storageBuffer->buffer(), 0, 1, sizeof(VkDrawIndirectCommand));
 
     vkCmdEndRenderPass(m_commandBuffers[i]);
 
-    // Release barrier
-    if (graphicsFamily.value() != computeFamily.value()) {
-      const VkBufferMemoryBarrier buffer_barrier = {
-          .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-          .srcAccessMask       = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-          .dstAccessMask       = 0,
-          .srcQueueFamilyIndex = graphicsFamily.value(),
-          .dstQueueFamilyIndex = computeFamily.value(),
-          .buffer              = storageBuffer->buffer(),
-          .offset              = 0,
-          .size                = storageBuffer->size(),
-      };
+    // No release barrier, the compute queue overwrites the render buffer without acquiring it back
 
-      vkCmdPipelineBarrier(m_commandBuffers[i], VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &buffer_barrier, 0, nullptr);
-    }
+    if (m_profiler) m_profiler->endGraphics(m_commandBuffers[i], image);
 
     if (vkEndCommandBuffer(m_commandBuffers.at(i)) != VK_SUCCESS) {
       throw std::runtime_error("failed to record command buffer!");
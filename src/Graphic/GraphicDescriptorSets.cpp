@@ -14,9 +14,8 @@ void GraphicDescriptorSets::createDescriptorSets() {
   std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 
   // On paramètre les descripteurs (on se rappelle que l'on en a mit un par frame)
-  const IUniformBuffers* ubo = m_uniformBuffers[0];
   for (size_t i = 0; i < m_descriptorSets.size(); i++) {
-    const VkDescriptorBufferInfo& bufferInfo = ubo->descriptor(i);
+    const VkDescriptorBufferInfo bufferInfo = m_graphicUniformBuffers.descriptor(i);
 
     writeDescriptorSets = {
         // Binding 2 :
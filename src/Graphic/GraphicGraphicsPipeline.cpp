@@ -2,7 +2,9 @@
 #include <Graphic/GraphicGraphicsPipeline.hpp>
 #include <particle_frag.h>                   // for PARTICLE_FRAG
 #include <particle_vert.h>                   // for PARTICLE_VERT
+#include <particle_vert_soa.h>               // for PARTICLE_VERT_SOA
 #include <struct/Particle.hpp>        // for Particle
+#include <struct/ParticlePosition.hpp>  // for ParticlePosition
 #include <stdexcept>                         // for runtime_error
 #include <vector>                            // for vector
 #include <poike/poike.hpp>
@@ -14,8 +16,12 @@ using namespace poike;
 GraphicGraphicsPipeline::GraphicGraphicsPipeline(const Device& device,
                                                  const SwapChain& swapChain,
                                                  const RenderPass& renderPass,
-                                                 const DescriptorSetLayout& descriptorSetLayout)
-    : GraphicsPipeline(device, swapChain, renderPass, descriptorSetLayout) {
+                                                 const DescriptorSetLayout& descriptorSetLayout,
+                                                 const PipelineCache& pipelineCache,
+                                                 ParticleLayout particleLayout)
+    : GraphicsPipeline(device, swapChain, renderPass, descriptorSetLayout),
+      m_pipelineCache(pipelineCache),
+      m_particleLayout(particleLayout) {
   createPipeline();
 }
 
@@ -45,8 +51,13 @@ void GraphicGraphicsPipeline::createPipeline() {
   VkPipelineColorBlendStateCreateInfo colorBlending;
   VkPipelineDepthStencilStateCreateInfo depthStencil;
 
-  initDefaultPipeline<Particle>(vertexInputInfo, inputAssembly, viewportState, rasterizer, multisampling, colorBlending,
-                                depthStencil);
+  if (m_particleLayout == ParticleLayout::SoA) {
+    initDefaultPipeline<ParticlePosition>(vertexInputInfo, inputAssembly, viewportState, rasterizer, multisampling,
+                                          colorBlending, depthStencil);
+  } else {
+    initDefaultPipeline<Particle>(vertexInputInfo, inputAssembly, viewportState, rasterizer, multisampling,
+                                  colorBlending, depthStencil);
+  }
 
   {
     inputAssembly.topology        = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
@@ -73,7 +84,8 @@ void GraphicGraphicsPipeline::createPipeline() {
         .pAttachments    = &blendAttachmentState,
     };
 
-    const VkShaderModule vertShaderModule = createShaderModule(PARTICLE_VERT);
+    const VkShaderModule vertShaderModule
+        = createShaderModule(m_particleLayout == ParticleLayout::SoA ? PARTICLE_VERT_SOA : PARTICLE_VERT);
     const VkShaderModule fragShaderModule = createShaderModule(PARTICLE_FRAG);
 
     shaderStages[0] = misc::pipelineShaderStageCreateInfo(vertShaderModule, VK_SHADER_STAGE_VERTEX_BIT);
@@ -99,7 +111,9 @@ void GraphicGraphicsPipeline::createPipeline() {
         .basePipelineIndex  = -1,
     };
 
-    if (vkCreateGraphicsPipelines(m_device.logical(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline)
+    // Recreated with each swap chain, the cache skips the shader compilation
+    if (vkCreateGraphicsPipelines(m_device.logical(), m_pipelineCache.handle(), 1, &pipelineInfo, nullptr,
+                                  &m_pipeline)
         != VK_SUCCESS) {
       throw std::runtime_error("Graphics Pipeline creation failed");
     }
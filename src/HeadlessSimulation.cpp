@@ -0,0 +1,256 @@
+// clang-format off
+#include <HeadlessSimulation.hpp>
+#include <WorkgroupTuning.hpp>
+#include <algorithm>                                     // for min
+#include <array>                                         // for array
+#include <cstdint>                                       // for uint32_t
+#include <limits>                                        // for numeric_limits
+#include <optional>                                      // for optional
+#include <stdexcept>                                     // for runtime_error
+#include <poike/poike.hpp>
+#include <struct/ComputeParticle.hpp>             // for ComputeParticle
+// clang-format on
+
+using namespace vkm;
+using namespace poike;
+
+HeadlessSimulation::HeadlessSimulation(const std::string& appName,
+                                       const DebugOption& debugOption,
+                                       const SimulationConfig& config,
+                                       const std::string& pipelineCacheFile)
+    : m_config(config),
+      m_parameters(m_config.instances, {m_config.dt, elastic_lambda, elastic_mu}),
+
+      // Device without surface, only its queues are used
+      instance(appName, debugOption),
+      device(instance, debugOption),
+
+      commandPool(device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT),
+      commandPoolCompute(device,
+                         VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                         device.queueFamilyIndices().computeFamily),
+      pipelineCache(device, pipelineCacheFile),
+
+      // Descriptor Pool
+      psCompute({
+          misc::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+          misc::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MPMStorageBuffer::numBuffers(m_config)),
+      }),
+      dpiCompute(misc::descriptorPoolCreateInfo(psCompute, MPMStorageBuffer::numBuffers(m_config) + 1)),
+      dpCompute(device, dpiCompute),
+
+      // Buffers
+      storageBuffer(device,
+                    m_config,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                        | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+      uniformBufferCompute(device, m_config.instances),
+      vecSBCompute(storageBuffer.buffers()),
+
+      // Compute
+      dslCompute(device,
+                 misc::descriptorSetLayoutCreateInfo(
+                     ComputeDescriptorSets::layoutBindings(vecSBCompute))),
+      dsCompute(device, dslCompute, dpCompute, vecSBCompute, uniformBufferCompute.buffers()),
+      gpCompute(device, dslCompute, m_config, pipelineCache),
+      // No swap chain, only the compute queries
+      m_profiler(device, m_config.substeps, 0),
+      cbCompute(device, gpCompute, vecSBCompute, commandPoolCompute, dsCompute, m_config, &m_profiler),
+      m_checkpoint(device, commandPoolCompute, cbCompute, m_config) {
+  const VkFenceCreateInfo fenceInfo = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+      .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+  };
+
+  for (VkFence& fence : m_fences) {
+    if (vkCreateFence(device.logical(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create fence!");
+    }
+  }
+
+  // The particles are placed and their volume estimated on the device
+  uniformBufferCompute.updateAll(m_parameters);
+  cbCompute.initialise();
+}
+
+HeadlessSimulation::~HeadlessSimulation() {
+  vkDeviceWaitIdle(device.logical());
+
+  for (VkFence& fence : m_fences) {
+    vkDestroyFence(device.logical(), fence, nullptr);
+  }
+}
+
+void HeadlessSimulation::run(uint32_t frames) {
+  uniformBufferCompute.updateAll(m_parameters);
+
+  // The compute command buffer starts with a barrier on the previous step, so it can be chained in one submission
+  std::vector<VkCommandBuffer> cmdBuffers(framesPerSubmit);
+
+  size_t batch = 0;
+  for (uint32_t done = 0; done < frames; ++batch) {
+    uint32_t count = std::min(frames - done, framesPerSubmit);
+    // the batches end on the exported frames
+    if (m_exporter) {
+      count = std::min(count, m_exporter->interval() - static_cast<uint32_t>(m_frames % m_exporter->interval()));
+    }
+    const VkFence& fence = m_fences[batch % m_fences.size()];
+
+    // some frames sort the particles first
+    for (uint32_t i = 0; i < count; ++i) {
+      cmdBuffers[i] = cbCompute.command(m_frames + i);
+    }
+
+    // Wait for the batch submitted two iterations ago
+    vkWaitForFences(device.logical(), 1, &fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device.logical(), 1, &fence);
+
+    const VkSubmitInfo submitInfo = {
+        .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = count,
+        .pCommandBuffers    = cmdBuffers.data(),
+    };
+
+    if (vkQueueSubmit(device.computeQueue(), 1, &submitInfo, fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit compute command buffer!");
+    }
+
+    // The queries are reset by each frame of the batch, only the last one is sampled
+    if (m_profiling) {
+      vkWaitForFences(device.logical(), 1, &fence, VK_TRUE, UINT64_MAX);
+      m_profiler.collectCompute();
+    }
+
+    // Saved once a batch crosses the interval, after it in the queue
+    if (!m_checkpointFile.empty() && m_checkpointInterval > 0
+        && (m_frames + count) / m_checkpointInterval > m_frames / m_checkpointInterval) {
+      m_checkpoint.save(m_checkpointFile, m_parameters.front());
+    }
+
+    done += count;
+    m_frames += count;
+
+    if (m_exporter) m_exporter->capture(m_frames);
+  }
+
+  // the frames captured are in the file once the run returns
+  if (m_exporter) m_exporter->flush();
+
+  if (!m_checkpointFile.empty()) {
+    // the periodic one may still be written
+    m_checkpoint.wait();
+    m_checkpoint.save(m_checkpointFile, m_parameters.front());
+    m_checkpoint.wait();
+  }
+
+  vkWaitForFences(device.logical(), static_cast<uint32_t>(m_fences.size()), m_fences.data(), VK_TRUE, UINT64_MAX);
+}
+
+void HeadlessSimulation::setParameters(uint32_t instance, const ComputeParticle& parameters) {
+  m_parameters.at(instance) = parameters;
+}
+
+void HeadlessSimulation::setCheckpoint(const std::string& filename, uint32_t interval) {
+  if (m_config.instances > 1) {
+    throw std::runtime_error("the checkpoints only hold a single instance!");
+  }
+
+  m_checkpointFile     = filename;
+  m_checkpointInterval = interval;
+}
+
+void HeadlessSimulation::setExport(const std::string& filename, uint32_t interval, FrameEncoding encoding) {
+  m_exporter.emplace(device, commandPoolCompute, cbCompute, m_config, filename, interval, encoding);
+}
+
+void HeadlessSimulation::restore(const std::string& filename) {
+  if (m_config.instances > 1) {
+    throw std::runtime_error("the checkpoints only hold a single instance!");
+  }
+
+  vkDeviceWaitIdle(device.logical());
+
+  m_parameters.assign(m_parameters.size(), m_checkpoint.load(filename));
+  uniformBufferCompute.updateAll(m_parameters);
+}
+
+void HeadlessSimulation::setWorkgroupSizes(const StepWorkgroupSizes& sizes) {
+  vkDeviceWaitIdle(device.logical());
+
+  m_config.stepWorkgroupSizes = sizes;
+  gpCompute.recreate();
+  cbCompute.recreate();
+
+  cbCompute.initialise();
+  m_frames = 0;
+}
+
+StepWorkgroupSizes HeadlessSimulation::tuneWorkgroupSizes() {
+  if (!m_profiler.enabled()) return m_config.stepWorkgroupSizes;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device.physical(), &properties);
+  const uint32_t maxSize
+      = std::min(properties.limits.maxComputeWorkGroupSize[0], properties.limits.maxComputeWorkGroupInvocations);
+
+  StepWorkgroupSizes best = m_config.stepWorkgroupSizes;
+  std::array<double, std::tuple_size_v<StepWorkgroupSizes>> bestTimes;
+  bestTimes.fill(std::numeric_limits<double>::max());
+
+  const bool profiling = m_profiling;
+  m_profiling          = true;
+
+  for (uint32_t size : tuningCandidates) {
+    if (size > maxSize) continue;
+
+    StepWorkgroupSizes sizes;
+    sizes.fill(size);
+    setWorkgroupSizes(sizes);
+
+    // one submission to warm the pipelines up, which is not measured
+    run(framesPerSubmit);
+    m_profiler.clearHistory();
+    run(tuningFrames);
+
+    // the passes of a step are in the order of GpuPass
+    for (size_t pass = 0; pass < bestTimes.size(); ++pass) {
+      const GpuProfiler::Stats stats = m_profiler.stats(static_cast<GpuPass>(pass));
+      if (stats.samples == 0) continue;
+
+      double time = stats.avg;
+
+      // the passes over the sparse grid share the clear grid size
+      if (m_config.gridMode == GridMode::Sparse && static_cast<StepPass>(pass) == StepPass::ClearGrid) {
+        time += m_profiler.stats(GpuPass::UpdateGrid).avg;
+      }
+
+      if (time < bestTimes[pass]) {
+        bestTimes[pass] = time;
+        best[pass]      = size;
+      }
+    }
+  }
+
+  m_profiling = profiling;
+  m_profiler.clearHistory();
+
+  setWorkgroupSizes(best);
+  return best;
+}
+
+StepWorkgroupSizes HeadlessSimulation::useTunedWorkgroupSizes(const std::string& filename) {
+  WorkgroupTuning tuning(filename);
+
+  if (const std::optional<StepWorkgroupSizes> sizes = tuning.find(device, m_config)) {
+    setWorkgroupSizes(*sizes);
+    return *sizes;
+  }
+
+  const StepWorkgroupSizes sizes = tuneWorkgroupSizes();
+  tuning.store(device, m_config, sizes);
+  // if it can't be written, they are tuned again by the next run
+  tuning.save();
+
+  return sizes;
+}
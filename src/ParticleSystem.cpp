@@ -1,11 +1,12 @@
 // clang-format off
 #include <ParticleSystem.hpp>
+#include <WorkgroupTuning.hpp>                           // for WorkgroupTuning
 #include <chrono>                                        // for duration
 #include <cstdint>                                       // for uint32_t
-#include <cstring>                                       // for memcpy
 #include <deque>                                         // for deque
 #include <memory>                                        // for allocator_tr...
 #include <stdexcept>                                     // for runtime_error
+#include <vector>                                        // for vector
 #include <poike/poike.hpp>
 #include <struct/ComputeParticle.hpp>             // for ComputeParticle
 #include <struct/ParticleMVP.hpp>                 // for ParticleMVP
@@ -22,6 +23,7 @@
 #include <Graphic/GraphicDescriptorSets.hpp>    // for GraphicDescr...
 #include <Graphic/GraphicGraphicsPipeline.hpp>  // for GraphicGraph...
 #include <Graphic/GraphicRenderPass.hpp>              // for GraphicRenderPass
+#include <Graphic/ParticleRenderBuffers.hpp>    // for ParticleRenderBuffers
 #include <glm/gtc/matrix_transform.hpp>
 // clang-format on
 
@@ -30,12 +32,8 @@ using namespace poike;
 
 static bool isPause = true;
 
-void updateGraphicsUniformBuffers(const Device& device,
-                                  const SwapChain& swapChain,
-                                  std::deque<Buffer<ParticleMVP>>& uniformBuffers,
-                                  float time,
-                                  uint32_t currentImage) {
-  ParticleMVP& ubo = uniformBuffers.at(currentImage).data().at(0);
+ParticleMVP graphicsParameters(const SwapChain& swapChain, const SimulationConfig& config) {
+  ParticleMVP ubo;
 
   ubo.model = glm::mat4(1.0f);
 
@@ -44,7 +42,9 @@ void updateGraphicsUniformBuffers(const Device& device,
   // rotM           = glm::rotate(rotM, glm::radians(75.0f), glm::vec3(0.0f, 1.0f, 0.0f));
   // rotM           = glm::rotate(rotM, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
-  ubo.view = glm::translate(glm::mat4(1.0f), glm::vec3(-32.0f, -32.0f, -5.0f)) * rotM;
+  // look at the center of the grid, from a distance proportional to its size
+  const float halfGrid = config.gridResolution / 2.0f;
+  ubo.view = glm::translate(glm::mat4(1.0f), glm::vec3(-halfGrid, -halfGrid, -5.0f * halfGrid / 32.0f)) * rotM;
 
   const float aspect = swapChain.extent().width / (float)swapChain.extent().height;
   ubo.proj           = glm::perspective(60.0f, aspect, 0.1f, 512.0f);
@@ -52,28 +52,15 @@ void updateGraphicsUniformBuffers(const Device& device,
 
   ubo.screenDim = glm::vec2(swapChain.extent().width, swapChain.extent().height);
 
-  void* data;
-  vkMapMemory(device.logical(), uniformBuffers[currentImage].memory(), 0, sizeof(ubo), 0, &data);
-  memcpy(data, &ubo, sizeof(ubo));
-  vkUnmapMemory(device.logical(), uniformBuffers[currentImage].memory());
+  return ubo;
 }
 
-void updateComputeUniformBuffers(const Device& device,
-                                 const SwapChain& swapChain,
-                                 std::deque<Buffer<ComputeParticle>>& uniformBuffers,
-                                 float time,
-                                 uint32_t currentImage) {
-  ComputeParticle& ubo = uniformBuffers.at(currentImage).data().at(0);
-
-  ubo.deltaT         = isPause ? 0.0f : DT;
-  ubo.particleCount  = NUM_PARTICLE;
-  ubo.elastic_lambda = elastic_lambda;
-  ubo.elastic_mu     = elastic_mu;
-
-  void* data;
-  vkMapMemory(device.logical(), uniformBuffers[currentImage].memory(), 0, sizeof(ubo), 0, &data);
-  memcpy(data, &ubo, sizeof(ubo));
-  vkUnmapMemory(device.logical(), uniformBuffers[currentImage].memory());
+ComputeParticle computeParticleParameters(const SimulationConfig& config) {
+  return {
+      .deltaT         = isPause ? 0.0f : config.dt,
+      .elastic_lambda = elastic_lambda,
+      .elastic_mu     = elastic_mu,
+  };
 }
 
 ParticleSystem::ParticleSystem(
@@ -81,7 +68,9 @@ ParticleSystem::ParticleSystem(
     android_app* androidApp,
 #endif
     const std::string& appName,
-    const DebugOption& debugOption)
+    const DebugOption& debugOption,
+    const SimulationConfig& config,
+    const std::string& pipelineCacheFile)
     : Application(
 #ifdef __ANDROID__
         androidApp,
@@ -89,6 +78,11 @@ ParticleSystem::ParticleSystem(
         appName,
         debugOption),
 
+      m_config(config),
+
+      // Shared by every pipeline, the graphics one is created again with each swap chain
+      pipelineCache(device, pipelineCacheFile),
+
       commandPool(device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT),
       // Use a separate command pool (queue family may differ from the one used for graphics)
       commandPoolCompute(device,
@@ -102,30 +96,33 @@ ParticleSystem::ParticleSystem(
       dpi(misc::descriptorPoolCreateInfo(ps, swapChain.numImages())),
       dp(device, dpi),
 
+      // A descriptor set per step in flight, each with its copy of the uniform buffer
       psCompute({
-          misc::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-          misc::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+          misc::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, ParticleRenderBuffers::size),
+          misc::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                   MPMStorageBuffer::numBuffers(m_config) * ParticleRenderBuffers::size),
       }),
-      dpiCompute(misc::descriptorPoolCreateInfo(psCompute, 4)),
+      dpiCompute(misc::descriptorPoolCreateInfo(psCompute, ParticleRenderBuffers::size)),
       dpCompute(device, dpiCompute),
 
       // Buffer
       // Graphic
-      uniformBuffersGraphic(device, swapChain, &updateGraphicsUniformBuffers),
+      uniformBuffersGraphic(device, swapChain),
 
       // Compute
       storageBuffer(device,
-                    commandPool,
-                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    m_config,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                        | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
-      uniformBuffersCompute(device, swapChain, &updateComputeUniformBuffers),
+      uniformBufferCompute(device, m_config.instances, ParticleRenderBuffers::size),
+      renderBuffers(device, m_config),
 
       // ~ My Vectors
       // Utile car sinon les pointeurs change, donc on copie d'abord par valeur
       // et on passe le vecteur qui sera concervé dans la class Application
-      vecUBGraphic({&uniformBuffersGraphic}),
-      vecUBCompute({&uniformBuffersCompute}),
-      vecSBCompute({&storageBuffer.ps, &storageBuffer.grid, &storageBuffer.fs}),
+      vecSBCompute(storageBuffer.buffers()),
+      vecRenderBuffers(renderBuffers.buffers()),
 
       /*
        * Basic Graphics
@@ -141,61 +138,70 @@ ParticleSystem::ParticleSystem(
                  })),
 
       // 3. Graphic Pipeline
-      gpGraphic(device, swapChain, rpGraphic, dslGraphic),
+      gpGraphic(device, swapChain, rpGraphic, dslGraphic, pipelineCache, m_config.layout),
 
       // 5. Descriptor Sets
-      dsGraphic(device, swapChain, dslGraphic, dp, {}, vecUBGraphic),
-
-      // Semaphore for compute & graphics sync
-      semaphoreGraphic(device),
+      dsGraphic(device, swapChain, dslGraphic, dp, {}, uniformBuffersGraphic),
 
       /*
        * Compute
        */
 
       // 2. Descriptor Set Layout
-      dslCompute(
-          device,
-          misc::descriptorSetLayoutCreateInfo({
-              // Binding 0 : Particle position storage buffer
-              misc::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
-              misc::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
-              misc::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
-              // Binding 1 : Uniform buffer
-              misc::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
-          })),
+      // Binding 0 : Particle (or position) storage buffer, 1 : grid, 2 : deformation gradients, 3 : Uniform buffer,
+      // 4 : sparse grid blocks, 5 to 7 : the other structure-of-arrays streams, 8 and 9 : particle sort, 10 : live
+      // particles, 11 : emitters
+      dslCompute(device,
+                 misc::descriptorSetLayoutCreateInfo(
+                     ComputeDescriptorSets::layoutBindings(vecSBCompute))),
 
       // 5. Descriptor Sets
-      dsCompute(device, swapChain, dslCompute, dpCompute, vecSBCompute, vecUBCompute),
+      dsCompute(device, dslCompute, dpCompute, vecSBCompute, uniformBufferCompute.buffers()),
 
       // 3. Compute Pipeline
-      gpCompute(device, swapChain, rpGraphic, dslCompute),
-
-      semaphoreCompute(device),
-
-      cbCompute(device, rpGraphic, gpCompute, vecSBCompute, commandPoolCompute, dsCompute),
-
-      cbGraphic(device, rpGraphic, swapChain, gpGraphic, commandPool, dsGraphic, vecSBCompute)
+      gpCompute(device, dslCompute, m_config, pipelineCache),
+
+      m_profiler(device, m_config.substeps, swapChain.numImages()),
+
+      cbCompute(device,
+                gpCompute,
+                vecSBCompute,
+                commandPoolCompute,
+                dsCompute,
+                m_config,
+                &m_profiler,
+                vecRenderBuffers),
+
+      cbGraphic(device,
+                rpGraphic,
+                swapChain,
+                gpGraphic,
+                commandPool,
+                dsGraphic,
+                vecRenderBuffers,
+                &m_profiler),
+      m_checkpoint(device, commandPoolCompute, cbCompute, m_config),
+
+      // The compute queue runs a step ahead at most: each one writes the render buffer drawn by the next frame
+      m_scheduler(device, MAX_FRAMES_IN_FLIGHT, ParticleRenderBuffers::size)
 #ifndef __ANDROID__
       /* ImGui */
       ,
       interface(instance, window, device, swapChain, gpGraphic)
 #endif
 {
-  // Trigger compute semaphore, to start by compute queue
-  {
-    const VkSubmitInfo submitInfo = {
-        .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores    = &semaphoreCompute.handle(),
-    };
-
-    // maybe graphics queue
-    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
-      throw std::runtime_error("failed to submit signal semaphore!");
-    }
-    vkQueueWaitIdle(device.graphicsQueue());
+  // Semaphores for compute & graphics sync, one pair per render buffer
+  for (size_t i = 0; i < ParticleRenderBuffers::size; ++i) {
+    computeLinks.emplace_back(device);
+    graphicsLinks.emplace_back(device);
   }
+
+  // The particles are placed and their volume estimated on the device, then copied to the render buffer of the
+  // previous compute step, drawn by the first frame. Both submissions are waited, so the first frame and step have no
+  // semaphore to wait.
+  uniformBufferCompute.updateAll(computeParticleParameters(m_config));
+  cbCompute.initialise();
+  cbCompute.fillRenderBuffer(ParticleRenderBuffers::index(ParticleRenderBuffers::size - 1));
 }
 
 void ParticleSystem::run() {
@@ -206,9 +212,57 @@ void ParticleSystem::run() {
 
   window.mainLoop();
   vkDeviceWaitIdle(device.logical());
+
+  if (!m_checkpointFile.empty()) {
+    // the periodic one may still be written
+    m_checkpoint.wait();
+    m_checkpoint.save(m_checkpointFile, {m_config.dt, elastic_lambda, elastic_mu});
+    m_checkpoint.wait();
+  }
+}
+
+void ParticleSystem::setCheckpoint(const std::string& filename, uint32_t interval) {
+  m_checkpointFile     = filename;
+  m_checkpointInterval = interval;
+}
+
+void ParticleSystem::setExport(const std::string& filename, uint32_t interval, FrameEncoding encoding) {
+  m_exporter.emplace(device, commandPoolCompute, cbCompute, m_config, filename, interval, encoding);
+}
+
+void ParticleSystem::setWorkgroupSizes(const StepWorkgroupSizes& sizes) {
+  vkDeviceWaitIdle(device.logical());
+
+  m_config.stepWorkgroupSizes = sizes;
+  gpCompute.recreate();
+  cbCompute.recreate();
+}
+
+bool ParticleSystem::useStoredWorkgroupSizes(const std::string& filename) {
+  const std::optional<StepWorkgroupSizes> sizes = WorkgroupTuning(filename).find(device, m_config);
+  if (!sizes) return false;
+
+  setWorkgroupSizes(*sizes);
+  return true;
+}
+
+void ParticleSystem::restore(const std::string& filename) {
+  vkDeviceWaitIdle(device.logical());
+
+  const ComputeParticle parameters = m_checkpoint.load(filename);
+  m_config.dt                      = parameters.deltaT;
+  elastic_lambda                   = parameters.elastic_lambda;
+  elastic_mu                       = parameters.elastic_mu;
+
+  // drawn by the next frame, as after the initialisation
+  uniformBufferCompute.updateAll(computeParticleParameters(m_config));
+  cbCompute.fillRenderBuffer(ParticleRenderBuffers::index(m_scheduler.step() + ParticleRenderBuffers::size - 1));
 }
 
 void ParticleSystem::drawFrame(bool& framebufferResized) {
+  // The synchronisation objects of the frame submitted MAX_FRAMES_IN_FLIGHT frames ago are used again
+  m_scheduler.waitFrameSlot();
+
   uint32_t imageIndex;
   VkResult result = prepareFrame(false, framebufferResized, imageIndex);
   if (result != VK_SUCCESS) return;
@@ -220,46 +274,52 @@ void ParticleSystem::drawFrame(bool& framebufferResized) {
 
   /* Update Uniform Buffers */
 
-  static auto startTime = std::chrono::high_resolution_clock::now();
+  uniformBuffersGraphic.update(imageIndex, graphicsParameters(swapChain, m_config));
 
-  auto currentTime = std::chrono::high_resolution_clock::now();
-  float time       = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+  // Timestamps of the last use of the command buffers, before they are submitted again
+  m_profiler.collectGraphics(imageIndex);
+  m_profiler.collectCompute();
 
-  uniformBuffersGraphic.update(time, imageIndex);
-  uniformBuffersCompute.update(time, imageIndex);
+  // The graphics queue draws the render buffer of the previous compute submission, while the compute queue simulates
+  // the next frame and then writes the other one
+  const uint64_t step  = m_scheduler.step();
+  const size_t drawn   = ParticleRenderBuffers::index(step + ParticleRenderBuffers::size - 1);
+  const size_t written = ParticleRenderBuffers::index(step);
 
   /* Submit graphics commands */
   {
     const std::vector<VkCommandBuffer> cmdBuffers = {
-        cbGraphic.command(imageIndex),
+        cbGraphic.command(imageIndex, drawn),
 #ifndef __ANDROID__
         interface.command(imageIndex),
 #endif
     };
 
-    const VkPipelineStageFlags waitStageMasks[] = {
-        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-    };
-    const VkSemaphore waitSemaphores[]   = {semaphoreCompute.handle(), syncObjects.imageAvailable(currentFrame)};
-    const VkSemaphore signalSemaphores[] = {semaphoreGraphic.handle(), syncObjects.renderFinished(currentFrame)};
+    std::vector<VkSemaphore> waitSemaphores, signalSemaphores;
+    std::vector<VkPipelineStageFlags> waitStageMasks;
+
+    computeLinks[drawn].wait(waitSemaphores, waitStageMasks, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    waitSemaphores.push_back(syncObjects.imageAvailable(currentFrame));
+    waitStageMasks.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    graphicsLinks[drawn].signal(signalSemaphores);
+    signalSemaphores.push_back(syncObjects.renderFinished(currentFrame));
 
     const VkSubmitInfo submitInfo = {
         .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount   = 2,
-        .pWaitSemaphores      = waitSemaphores,
-        .pWaitDstStageMask    = waitStageMasks,
+        .waitSemaphoreCount   = static_cast<uint32_t>(waitSemaphores.size()),
+        .pWaitSemaphores      = waitSemaphores.data(),
+        .pWaitDstStageMask    = waitStageMasks.data(),
         .commandBufferCount   = static_cast<uint32_t>(cmdBuffers.size()),
         .pCommandBuffers      = cmdBuffers.data(),
-        .signalSemaphoreCount = 2,
-        .pSignalSemaphores    = signalSemaphores,
+        .signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size()),
+        .pSignalSemaphores    = signalSemaphores.data(),
     };
 
-    // vkResetFences(device.logical(), 1, &syncObjects.inFlightFence(currentFrame));
-
-    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, m_scheduler.frameFence()) != VK_SUCCESS) {
       throw std::runtime_error("failed to submit draw command buffer!");
     }
+    m_scheduler.frameSubmitted();
   }
 
   submitFrame(false, framebufferResized, imageIndex);
@@ -267,27 +327,43 @@ void ParticleSystem::drawFrame(bool& framebufferResized) {
   /* Submit compute commands */
   {
     const std::vector<VkCommandBuffer> cmdBuffers = {
-        cbCompute.command(),
+        cbCompute.command(step),
     };
 
-    const VkPipelineStageFlags waitStageMasks[] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
-    const VkSemaphore waitSemaphores[]          = {semaphoreGraphic.handle()};
-    const VkSemaphore signalSemaphores[]        = {semaphoreCompute.handle()};
+    // Only the copy at the end waits for the graphics queue to be done with the render buffer
+    std::vector<VkSemaphore> waitSemaphores, signalSemaphores;
+    std::vector<VkPipelineStageFlags> waitStageMasks;
+
+    graphicsLinks[written].wait(waitSemaphores, waitStageMasks, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    computeLinks[written].signal(signalSemaphores);
 
     const VkSubmitInfo computeSubmitInfo = {
         .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount   = 1,
-        .pWaitSemaphores      = waitSemaphores,
-        .pWaitDstStageMask    = waitStageMasks,
+        .waitSemaphoreCount   = static_cast<uint32_t>(waitSemaphores.size()),
+        .pWaitSemaphores      = waitSemaphores.data(),
+        .pWaitDstStageMask    = waitStageMasks.data(),
         .commandBufferCount   = static_cast<uint32_t>(cmdBuffers.size()),
         .pCommandBuffers      = cmdBuffers.data(),
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores    = signalSemaphores,
+        .signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size()),
+        .pSignalSemaphores    = signalSemaphores.data(),
     };
 
-    if (vkQueueSubmit(device.computeQueue(), 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    // Blocks while stepsInFlight steps are still running, the parameters are then written to the copy of the uniform
+    // buffer which the step stepsInFlight before this one was reading
+    m_scheduler.waitStepSlot();
+    uniformBufferCompute.update(step, computeParticleParameters(m_config));
+
+    if (vkQueueSubmit(device.computeQueue(), 1, &computeSubmitInfo, m_scheduler.stepFence()) != VK_SUCCESS) {
       throw std::runtime_error("failed to submit draw command buffer!");
     }
+    m_scheduler.stepSubmitted();
+  }
+
+  if (m_exporter && !isPause) m_exporter->capture(step + 1);
+
+  // Copied after the step in the compute queue, skipped while the previous one is still written
+  if (!m_checkpointFile.empty() && m_checkpointInterval > 0 && !isPause && (step + 1) % m_checkpointInterval == 0) {
+    m_checkpoint.save(m_checkpointFile, {m_config.dt, elastic_lambda, elastic_mu});
   }
 
   currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
@@ -320,7 +396,31 @@ void ParticleSystem::drawImGui() {
     }
     ImGui::SameLine();
     if (ImGui::Button("Restart")) {
-      storageBuffer.recreate();
+      vkDeviceWaitIdle(device.logical());
+      uniformBufferCompute.updateAll(computeParticleParameters(m_config));
+      cbCompute.initialise();
+      // drawn by the next frame, as after a restore
+      cbCompute.fillRenderBuffer(ParticleRenderBuffers::index(m_scheduler.step() + ParticleRenderBuffers::size - 1));
+    }
+
+    if (!m_checkpointFile.empty()) {
+      static std::string checkpointError;
+
+      if (ImGui::Button("Save state")) {
+        m_checkpoint.save(m_checkpointFile, {m_config.dt, elastic_lambda, elastic_mu});
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Load state")) {
+        try {
+          restore(m_checkpointFile);
+          checkpointError.clear();
+        } catch (const std::exception& e) {
+          checkpointError = e.what();
+        }
+      }
+
+      if (m_checkpoint.failed()) ImGui::Text("checkpoint not written");
+      if (!checkpointError.empty()) ImGui::Text("%s", checkpointError.c_str());
     }
 
     ImGui::Separator();
@@ -337,6 +437,39 @@ void ParticleSystem::drawImGui() {
 
     ImGui::SliderFloat("lambda", &(elastic_lambda), 10.0f, 100.0f);
     ImGui::SliderFloat("mu", &(elastic_mu), 0.1f, 20.0f);
+
+    // The gravity is compiled into the shaders, their variant is switched once the slider is released
+    ImGui::SliderFloat("gravity", &(m_config.gravity), -1.0f, 1.0f);
+    if (ImGui::IsItemDeactivatedAfterEdit()) {
+      vkDeviceWaitIdle(device.logical());
+      gpCompute.recreate();
+      cbCompute.recreate();
+    }
+
+    ImGui::Separator();
+    ImGui::Text("Time Step");
+    ImGui::SliderFloat("dt", &(m_config.dt), 0.001f, 0.2f);
+
+    int substeps = static_cast<int>(m_config.substeps);
+    if (ImGui::SliderInt("substeps", &substeps, 1, 32)) {
+      m_config.substeps = static_cast<uint32_t>(substeps);
+
+      // The substeps are recorded in the compute command buffer, as well as the timestamps of each of them
+      vkDeviceWaitIdle(device.logical());
+      m_profiler.recreate(m_config.substeps, swapChain.numImages());
+      cbCompute.recreate();
+      cbGraphic.recreate();
+    }
+
+    if (m_profiler.enabled()) {
+      ImGui::Separator();
+      ImGui::Text("GPU Timings (ms, min / avg / p99)");
+      for (size_t pass = 0; pass < GpuProfiler::numPasses; ++pass) {
+        const GpuProfiler::Stats stats = m_profiler.stats(static_cast<GpuPass>(pass));
+        ImGui::Text("%-12s %.3f / %.3f / %.3f", GpuProfiler::name(static_cast<GpuPass>(pass)), stats.min, stats.avg,
+                    stats.p99);
+      }
+    }
   }
 
   ImGui::End();
@@ -361,7 +494,11 @@ void ParticleSystem::recreateSwapChain(bool& framebufferResized) {
 
   // Recreated because the number of buffer is based on number of image in swapchain
   uniformBuffersGraphic.recreate();
-  uniformBuffersCompute.recreate();
+
+  // The graphics timestamps follow the compute ones in the query pool, so it is only recreated when the number of
+  // images changes, along with the compute command buffers which refer to it
+  const bool numImagesChanged = (swapChain.numImages() != m_profiler.numImages());
+  if (numImagesChanged) m_profiler.recreate(m_config.substeps, swapChain.numImages());
 
   /**
    * Graphic
@@ -375,10 +512,8 @@ void ParticleSystem::recreateSwapChain(bool& framebufferResized) {
   /**
    * Compute
    */
-  gpCompute.recreate();
-  dpCompute.recreate();
-  dsCompute.recreate();
-  cbCompute.recreate();
+  // The compute pipelines don't depend on the swap chain
+  if (numImagesChanged) cbCompute.recreate();
 
 #ifndef __ANDROID__
   interface.recreate();
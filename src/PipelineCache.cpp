@@ -0,0 +1,81 @@
+// clang-format off
+#include <PipelineCache.hpp>
+#include <cstring>                                       // for memcmp, memcpy
+#include <fstream>                                       // for ifstream, ofstream
+#include <stdexcept>                                     // for runtime_error
+#include <poike/poike.hpp>
+// clang-format on
+
+using namespace vkm;
+using namespace poike;
+
+PipelineCache::PipelineCache(const Device& device, const std::string& filename)
+    : m_device(device), m_filename(filename) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(m_device.physical(), &properties);
+
+  m_header = {
+      .magic         = fileMagic,
+      .vendorID      = properties.vendorID,
+      .deviceID      = properties.deviceID,
+      .driverVersion = properties.driverVersion,
+  };
+  std::memcpy(m_header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+  // The driver also checks its own header, and starts from an empty cache if the data doesn't match
+  const std::vector<char> data = load();
+
+  const VkPipelineCacheCreateInfo createInfo = {
+      .sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .initialDataSize = data.size(),
+      .pInitialData    = data.empty() ? nullptr : data.data(),
+  };
+
+  if (vkCreatePipelineCache(m_device.logical(), &createInfo, nullptr, &m_cache) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+PipelineCache::~PipelineCache() {
+  save();
+  vkDestroyPipelineCache(m_device.logical(), m_cache, nullptr);
+}
+
+std::vector<char> PipelineCache::load() const {
+  if (m_filename.empty()) return {};
+
+  std::ifstream file(m_filename, std::ios::binary | std::ios::ate);
+  if (!file) return {};
+
+  const std::streamsize size = file.tellg();
+  if (size <= static_cast<std::streamsize>(sizeof(FileHeader))) return {};
+  file.seekg(0);
+
+  // Written by another device, driver or version of the application
+  FileHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+      || std::memcmp(&header, &m_header, sizeof(header)) != 0) {
+    return {};
+  }
+
+  std::vector<char> data(size - sizeof(FileHeader));
+  if (!file.read(data.data(), data.size())) return {};
+
+  return data;
+}
+
+bool PipelineCache::save() const {
+  if (m_filename.empty()) return true;
+
+  size_t size = 0;
+  if (vkGetPipelineCacheData(m_device.logical(), m_cache, &size, nullptr) != VK_SUCCESS) return false;
+
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(m_device.logical(), m_cache, &size, data.data()) != VK_SUCCESS) return false;
+
+  std::ofstream file(m_filename, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+  file.write(data.data(), size);
+
+  return static_cast<bool>(file);
+}
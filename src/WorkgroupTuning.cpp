@@ -0,0 +1,88 @@
+// clang-format off
+#include <WorkgroupTuning.hpp>
+#include <filesystem>                                    // for path
+#include <fstream>                                       // for ifstream, ofstream
+#include <sstream>                                       // for istringstream, ostringstream
+#include <poike/poike.hpp>
+// clang-format on
+
+using namespace vkm;
+using namespace poike;
+
+WorkgroupTuning::WorkgroupTuning(const std::string& filename) : m_filename(filename) {
+  std::ifstream file(m_filename);
+
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+
+    std::istringstream is(line);
+    std::string entry;
+    StepWorkgroupSizes sizes;
+
+    is >> entry;
+    for (uint32_t& size : sizes) {
+      is >> size;
+    }
+
+    // a truncated line is dropped, it is measured again
+    if (!is.fail()) m_entries[entry] = sizes;
+  }
+}
+
+std::string WorkgroupTuning::filename(const std::string& pipelineCacheFile) {
+  return std::filesystem::path(pipelineCacheFile).replace_extension(".workgroups").string();
+}
+
+std::optional<StepWorkgroupSizes> WorkgroupTuning::find(const Device& device, const SimulationConfig& config) const {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device.physical(), &properties);
+
+  return find(properties, config);
+}
+
+void WorkgroupTuning::store(const Device& device, const SimulationConfig& config, const StepWorkgroupSizes& sizes) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device.physical(), &properties);
+
+  store(properties, config, sizes);
+}
+
+std::optional<StepWorkgroupSizes> WorkgroupTuning::find(const VkPhysicalDeviceProperties& properties,
+                                                        const SimulationConfig& config) const {
+  const auto it = m_entries.find(key(properties, config));
+  if (it == m_entries.end()) return std::nullopt;
+
+  return it->second;
+}
+
+void WorkgroupTuning::store(const VkPhysicalDeviceProperties& properties,
+                            const SimulationConfig& config,
+                            const StepWorkgroupSizes& sizes) {
+  m_entries[key(properties, config)] = sizes;
+}
+
+bool WorkgroupTuning::save() const {
+  std::ofstream file(m_filename, std::ios::trunc);
+
+  file << "# device:driver/p2g/layout/grid/fused, then the workgroup size of clear grid, P2G, update grid and G2P\n";
+  for (const auto& [entry, sizes] : m_entries) {
+    file << entry;
+    for (uint32_t size : sizes) {
+      file << " " << size;
+    }
+    file << "\n";
+  }
+
+  return static_cast<bool>(file);
+}
+
+std::string WorkgroupTuning::key(const VkPhysicalDeviceProperties& properties, const SimulationConfig& config) {
+  // one entry per variant of the shaders, whatever the sizes of the simulation
+  std::ostringstream os;
+  os << std::hex << properties.vendorID << "-" << properties.deviceID << ":" << properties.driverVersion << std::dec
+     << "/" << static_cast<int>(config.p2gMode) << "/" << static_cast<int>(config.layout) << "/"
+     << static_cast<int>(config.gridMode) << "/" << (config.fuseGridPasses ? 1 : 0);
+
+  return os.str();
+}
@@ -0,0 +1,135 @@
+#include <catch2/catch.hpp>
+#include <Checkpoint.hpp>                // for Checkpoint, CheckpointHeader
+#include <Compute/MPMStorageBuffer.hpp>  // for MPMStorageBuffer
+#include <SimulationConfig.hpp>          // for SimulationConfig, ParticleLayout
+#include <struct/ComputeParticle.hpp>    // for ComputeParticle
+#include <struct/ParticleCounter.hpp>    // for ParticleCounter
+#include <algorithm>                     // for equal
+#include <cstddef>                       // for size_t, offsetof
+#include <cstring>                       // for memcpy
+#include <filesystem>                    // for temp_directory_path, remove
+#include <fstream>                       // for ifstream, fstream
+#include <stdexcept>                     // for runtime_error
+#include <string>                        // for string
+#include <vector>                        // for vector
+
+using namespace vkm;
+
+namespace {
+
+  constexpr uint32_t liveParticles = 40;
+  constexpr uint32_t sequence      = 7;
+
+  constexpr ComputeParticle parameters = {
+      .deltaT         = 0.05f,
+      .elastic_lambda = 50.0f,
+      .elastic_mu     = 2.0f,
+  };
+
+  SimulationConfig checkpointConfig(ParticleLayout layout) {
+    SimulationConfig config;
+    config.numParticles = 64;
+    config.layout       = layout;
+    return config;
+  }
+
+  // A staging buffer as copied by the device: the counter, then each stream up to the capacity, the bytes of the
+  // streams numbered so that a misplaced one shows
+  std::vector<char> stagingData(const SimulationConfig& config) {
+    size_t size = sizeof(ParticleCounter);
+    for (const MPMStorageBuffer::ParticleStream& stream : MPMStorageBuffer::particleStreams(config)) {
+      size += config.particleCapacity() * stream.stride;
+    }
+
+    std::vector<char> data(size);
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = static_cast<char>(i * 31 + 1);
+    }
+
+    ParticleCounter counter = {};
+    counter.count           = liveParticles;
+    counter.capacity        = config.particleCapacity();
+    counter.sequence        = sequence;
+    std::memcpy(data.data(), &counter, sizeof(counter));
+
+    return data;
+  }
+
+  // Removed at the end of the test
+  struct TemporaryFile {
+    const std::string name = (std::filesystem::temp_directory_path() / "vkMpm_tests.ckp").string();
+
+    TemporaryFile() { std::filesystem::remove(name); }
+    ~TemporaryFile() { std::filesystem::remove(name); }
+  };
+
+  // Overwrite a field of the header of the file
+  template <typename T> void patchHeader(const std::string& filename, size_t offset, const T& value) {
+    std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  CheckpointHeader readHeader(const std::string& filename, const SimulationConfig& config) {
+    std::ifstream file(filename, std::ios::binary);
+    return Checkpoint::readHeader(file, filename, config);
+  }
+
+}  // namespace
+
+TEST_CASE("A checkpoint reads back as it was written", "[Checkpoint]") {
+  const SimulationConfig config = checkpointConfig(GENERATE(ParticleLayout::AoS, ParticleLayout::SoA));
+  const TemporaryFile file;
+
+  const std::vector<char> data = stagingData(config);
+  REQUIRE(Checkpoint::write(file.name, data.data(), config, parameters));
+
+  std::ifstream is(file.name, std::ios::binary);
+  const CheckpointHeader header = Checkpoint::readHeader(is, file.name, config);
+
+  CHECK(header.version == Checkpoint::version);
+  CHECK(header.gridResolution == config.gridResolution);
+  CHECK(header.count == liveParticles);
+  CHECK(header.sequence == sequence);
+  CHECK(header.parameters.deltaT == parameters.deltaT);
+  CHECK(header.parameters.elastic_lambda == parameters.elastic_lambda);
+  CHECK(header.parameters.elastic_mu == parameters.elastic_mu);
+
+  // only the live particles of each stream, one stream after the other
+  const char* stream = data.data() + sizeof(ParticleCounter);
+  for (const MPMStorageBuffer::ParticleStream& particleStream : MPMStorageBuffer::particleStreams(config)) {
+    std::vector<char> particles(liveParticles * particleStream.stride);
+    REQUIRE(is.read(particles.data(), static_cast<std::streamsize>(particles.size())));
+    CHECK(std::equal(particles.begin(), particles.end(), stream));
+
+    stream += config.particleCapacity() * particleStream.stride;
+  }
+
+  CHECK(is.peek() == std::ifstream::traits_type::eof());
+}
+
+TEST_CASE("A checkpoint of another format or simulation is rejected", "[Checkpoint]") {
+  const SimulationConfig config = checkpointConfig(ParticleLayout::AoS);
+  const TemporaryFile file;
+
+  const std::vector<char> data = stagingData(config);
+  REQUIRE(Checkpoint::write(file.name, data.data(), config, parameters));
+  REQUIRE_NOTHROW(readHeader(file.name, config));
+
+  SECTION("bad magic") { patchHeader(file.name, offsetof(CheckpointHeader, magic), 'X'); }
+  SECTION("another version") {
+    patchHeader(file.name, offsetof(CheckpointHeader, version), Checkpoint::version + 1);
+  }
+  SECTION("another layout") {
+    patchHeader(file.name, offsetof(CheckpointHeader, layout), static_cast<uint32_t>(ParticleLayout::SoA));
+  }
+  SECTION("another grid") {
+    patchHeader(file.name, offsetof(CheckpointHeader, gridResolution), config.gridResolution * 2);
+  }
+  SECTION("more particles than the buffers hold") {
+    patchHeader(file.name, offsetof(CheckpointHeader, count), config.particleCapacity() + 1);
+  }
+  SECTION("truncated header") { std::filesystem::resize_file(file.name, sizeof(CheckpointHeader) / 2); }
+
+  CHECK_THROWS_AS(readHeader(file.name, config), std::runtime_error);
+}
@@ -0,0 +1,145 @@
+#include <catch2/catch.hpp>
+#include <Cpu/SimdKernels.hpp>         // for SimdKernels, ParticleStreams, selectSimdKernels
+#include <struct/Cell.hpp>             // for Cell
+#include <struct/ComputeParticle.hpp>  // for ELASTIC_LAMBDA, ELASTIC_MU
+#include <cstddef>                     // for size_t
+#include <random>                      // for mt19937, uniform_real_distribution
+#include <stdexcept>                   // for runtime_error
+#include <vector>                      // for vector
+
+using namespace vkm;
+
+namespace {
+
+  constexpr int gridResolution = 32;
+
+  // Not a multiple of any SIMD width, so the scalar tail runs too
+  constexpr size_t numParticles = 1001;
+
+  constexpr KernelParameters parameters = {
+      .dt             = 0.1f,
+      .elastic_lambda = ELASTIC_LAMBDA,
+      .elastic_mu     = ELASTIC_MU,
+      .gridResolution = gridResolution,
+  };
+
+  // ParticleStreams::count consecutive streams of numParticles floats
+  struct Particles {
+    std::vector<float> storage = std::vector<float>(ParticleStreams::count * numParticles);
+
+    inline float* stream(size_t i) { return storage.data() + i * numParticles; }
+
+    ParticleStreams streams() {
+      return {
+          .posX   = stream(0),
+          .posY   = stream(1),
+          .velX   = stream(2),
+          .velY   = stream(3),
+          .c00    = stream(4),
+          .c01    = stream(5),
+          .c10    = stream(6),
+          .c11    = stream(7),
+          .f00    = stream(8),
+          .f01    = stream(9),
+          .f10    = stream(10),
+          .f11    = stream(11),
+          .mass   = stream(12),
+          .volume = stream(13),
+      };
+    }
+  };
+
+  // The same particles on every run: in the interior of the grid, moving, sheared and slightly deformed
+  Particles fixedParticles() {
+    Particles particles;
+    const ParticleStreams p = particles.streams();
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> position(4.0f, gridResolution - 4.0f);
+    std::uniform_real_distribution<float> small(-0.1f, 0.1f);
+
+    for (size_t i = 0; i < numParticles; ++i) {
+      p.posX[i]   = position(generator);
+      p.posY[i]   = position(generator);
+      p.velX[i]   = 10.0f * small(generator);
+      p.velY[i]   = 10.0f * small(generator);
+      p.c00[i]    = small(generator);
+      p.c01[i]    = small(generator);
+      p.c10[i]    = small(generator);
+      p.c11[i]    = small(generator);
+      p.f00[i]    = 1.0f + small(generator);
+      p.f01[i]    = small(generator);
+      p.f10[i]    = small(generator);
+      p.f11[i]    = 1.0f + small(generator);
+      p.mass[i]   = 1.0f;
+      p.volume[i] = 0.25f;
+    }
+
+    return particles;
+  }
+
+  std::vector<Cell> particleToGrid(const SimdKernels& kernels, Particles particles) {
+    std::vector<Cell> grid(gridResolution * gridResolution, Cell{});
+    kernels.particleToGrid(particles.streams(), 0, numParticles, parameters, grid.data());
+    return grid;
+  }
+
+  // The momentum of the scalar P2G as a velocity, as after the grid update
+  std::vector<Cell> velocityGrid() {
+    std::vector<Cell> grid = particleToGrid(*scalarKernels(), fixedParticles());
+    for (Cell& cell : grid) {
+      if (cell.mass > 0.0f) cell.vel /= cell.mass;
+    }
+    return grid;
+  }
+
+  Particles gridToParticle(const SimdKernels& kernels, const std::vector<Cell>& grid) {
+    Particles particles = fixedParticles();
+    kernels.gridToParticle(particles.streams(), 0, numParticles, parameters, grid.data());
+    return particles;
+  }
+
+  // The kernels of the level, or nullptr if this build or CPU doesn't have them
+  const SimdKernels* kernelsOf(SimdLevel level) {
+    try {
+      return &selectSimdKernels(level);
+    } catch (const std::runtime_error&) {
+      return nullptr;
+    }
+  }
+
+}  // namespace
+
+TEST_CASE("The SIMD kernels match the scalar ones", "[SimdKernels]") {
+  const SimdLevel level = GENERATE(SimdLevel::SSE, SimdLevel::AVX2, SimdLevel::AVX512);
+
+  const SimdKernels* kernels = kernelsOf(level);
+  if (kernels == nullptr) return;
+
+  INFO(kernels->name);
+
+  SECTION("P2G scatters the same grid") {
+    const std::vector<Cell> expected = particleToGrid(*scalarKernels(), fixedParticles());
+    const std::vector<Cell> grid     = particleToGrid(*kernels, fixedParticles());
+
+    for (size_t i = 0; i < grid.size(); ++i) {
+      INFO("cell " << i);
+      CHECK(grid[i].mass == Approx(expected[i].mass).margin(1e-4));
+      CHECK(grid[i].vel.x == Approx(expected[i].vel.x).margin(1e-4));
+      CHECK(grid[i].vel.y == Approx(expected[i].vel.y).margin(1e-4));
+    }
+  }
+
+  SECTION("G2P gathers the same particles") {
+    const std::vector<Cell> grid = velocityGrid();
+    Particles expected           = gridToParticle(*scalarKernels(), grid);
+    Particles particles          = gridToParticle(*kernels, grid);
+
+    for (size_t stream = 0; stream < ParticleStreams::count; ++stream) {
+      for (size_t i = 0; i < numParticles; ++i) {
+        INFO("stream " << stream << ", particle " << i);
+        CHECK(particles.stream(stream)[i] == Approx(expected.stream(stream)[i]).margin(1e-4));
+      }
+    }
+  }
+}
@@ -0,0 +1,66 @@
+#include <catch2/catch.hpp>
+#include <SimulationConfig.hpp>  // for SimulationConfig
+#include <struct/Emitter.hpp>    // for Emitter
+#include <stdexcept>             // for runtime_error
+
+using namespace vkm;
+
+namespace {
+
+  Emitter emitter() {
+    return {
+        .center   = {32.0f, 32.0f},
+        .size     = {4.0f, 4.0f},
+        .velocity = {0.0f, -1.0f},
+        .shape    = EmitterShape::Box,
+        .rate     = 16,
+    };
+  }
+
+}  // namespace
+
+TEST_CASE("The default configuration is valid", "[SimulationConfig]") {
+  CHECK_NOTHROW(SimulationConfig().validate());
+}
+
+TEST_CASE("validate rejects the configurations the passes can't run", "[SimulationConfig]") {
+  SimulationConfig config;
+
+  SECTION("no particle nor emitter") { config.numParticles = 0; }
+  SECTION("a capacity below the particles") { config.capacity = config.numParticles - 1; }
+  SECTION("too many emitters") { config.emitters.assign(SimulationConfig::maxEmitters + 1, emitter()); }
+  SECTION("an emitter out of the fixed-point range") {
+    Emitter fast    = emitter();
+    fast.velocity   = {SimulationConfig::fixedPointRange, 0.0f};
+    config.emitters = {fast};
+  }
+  SECTION("no substep") { config.substeps = 0; }
+  SECTION("no time step") { config.dt = 0.0f; }
+  SECTION("no instance") { config.instances = 0; }
+  SECTION("too many instances") { config.instances = SimulationConfig::maxInstances + 1; }
+  SECTION("instances on a sparse grid") {
+    config.instances = 2;
+    config.gridMode  = GridMode::Sparse;
+  }
+  SECTION("instances with emitters") {
+    config.instances = 2;
+    config.emitters  = {emitter()};
+  }
+  SECTION("empty workgroups") { config.workgroupSize = 0; }
+  SECTION("a sparse grid out of whole blocks") {
+    config.gridMode       = GridMode::Sparse;
+    config.gridResolution = SimulationConfig::blockSide * 8 + 1;
+  }
+  SECTION("a grid too small for the particles") { config.gridResolution = 16; }
+
+  CHECK_THROWS_AS(config.validate(), std::runtime_error);
+}
+
+TEST_CASE("validate accepts the emitters without initial particles", "[SimulationConfig]") {
+  SimulationConfig config;
+  config.numParticles = 0;
+  config.capacity     = 1024;
+  config.emitters     = {emitter()};
+
+  CHECK_NOTHROW(config.validate());
+}
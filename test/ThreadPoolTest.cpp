@@ -0,0 +1,57 @@
+#include <catch2/catch.hpp>
+#include <Cpu/ThreadPool.hpp>  // for ThreadPool
+#include <atomic>              // for atomic
+#include <cstddef>             // for size_t
+#include <stdexcept>           // for runtime_error
+#include <vector>              // for vector
+
+using namespace vkm;
+
+TEST_CASE("parallelFor runs every index once", "[ThreadPool]") {
+  const size_t numThreads = GENERATE(1, 2, 8);
+  ThreadPool pool(numThreads);
+
+  const size_t count = 10007;
+  std::vector<std::atomic<int>> runs(count);
+  std::atomic<bool> slotInRange = true;
+
+  pool.parallelFor(count, 64, [&](size_t begin, size_t end, size_t slot) {
+    if (slot >= pool.concurrency()) slotInRange = false;
+    for (size_t i = begin; i < end; ++i) ++runs[i];
+  });
+
+  CHECK(slotInRange);
+  for (size_t i = 0; i < count; ++i) {
+    INFO("index " << i);
+    CHECK(runs[i] == 1);
+  }
+}
+
+TEST_CASE("parallelFor with nothing to run returns at once", "[ThreadPool]") {
+  ThreadPool pool(4);
+
+  bool called = false;
+  pool.parallelFor(0, 16, [&](size_t, size_t, size_t) { called = true; });
+
+  CHECK_FALSE(called);
+}
+
+TEST_CASE("parallelFor rethrows the exception of a chunk once they are all done", "[ThreadPool]") {
+  ThreadPool pool(4);
+
+  const size_t count        = 1000;
+  std::atomic<size_t> done = 0;
+
+  CHECK_THROWS_AS(pool.parallelFor(count, 10,
+                                   [&](size_t begin, size_t end, size_t) {
+                                     done += end - begin;
+                                     if (begin == 500) throw std::runtime_error("chunk failed");
+                                   }),
+                  std::runtime_error);
+  CHECK(done == count);
+
+  // the workers survive it
+  done = 0;
+  pool.parallelFor(count, 10, [&](size_t begin, size_t end, size_t) { done += end - begin; });
+  CHECK(done == count);
+}
@@ -0,0 +1,89 @@
+#include <catch2/catch.hpp>
+#include <SimulationConfig.hpp>  // for SimulationConfig, StepWorkgroupSizes
+#include <WorkgroupTuning.hpp>   // for WorkgroupTuning
+#include <filesystem>            // for temp_directory_path, remove
+#include <fstream>               // for ifstream, ofstream
+#include <iterator>              // for istreambuf_iterator
+#include <string>                // for string
+
+using namespace vkm;
+
+namespace {
+
+  VkPhysicalDeviceProperties deviceProperties(uint32_t deviceID) {
+    VkPhysicalDeviceProperties properties = {};
+    properties.vendorID                   = 0x10de;
+    properties.deviceID                   = deviceID;
+    properties.driverVersion              = 0x1234;
+    return properties;
+  }
+
+  // Removed at the end of the test
+  struct TemporaryFile {
+    const std::string name = (std::filesystem::temp_directory_path() / "vkMpm_tests.workgroups").string();
+
+    TemporaryFile() { std::filesystem::remove(name); }
+    ~TemporaryFile() { std::filesystem::remove(name); }
+  };
+
+}  // namespace
+
+TEST_CASE("The tuning file sits next to the pipeline cache", "[WorkgroupTuning]") {
+  const std::filesystem::path filename = WorkgroupTuning::filename("cache/pipeline.bin");
+  CHECK(filename == std::filesystem::path("cache/pipeline.workgroups"));
+}
+
+TEST_CASE("The stored sizes are found again once saved", "[WorkgroupTuning]") {
+  const TemporaryFile file;
+  const SimulationConfig config;
+  const StepWorkgroupSizes sizes = {64, 128, 256, 32};
+
+  {
+    WorkgroupTuning tuning(file.name);
+    CHECK_FALSE(tuning.find(deviceProperties(1), config).has_value());
+
+    tuning.store(deviceProperties(1), config, sizes);
+    REQUIRE(tuning.save());
+  }
+
+  const WorkgroupTuning tuning(file.name);
+  REQUIRE(tuning.find(deviceProperties(1), config).has_value());
+  CHECK(*tuning.find(deviceProperties(1), config) == sizes);
+
+  // another device, or another variant of the shaders, is tuned on its own
+  CHECK_FALSE(tuning.find(deviceProperties(2), config).has_value());
+
+  SimulationConfig tiled = config;
+  tiled.p2gMode          = P2GMode::Tiled;
+  CHECK_FALSE(tuning.find(deviceProperties(1), tiled).has_value());
+
+  // but not another size of simulation
+  SimulationConfig larger = config;
+  larger.numParticles     = 2 * config.numParticles;
+  CHECK(tuning.find(deviceProperties(1), larger).has_value());
+}
+
+TEST_CASE("The comments and truncated lines of the file are skipped", "[WorkgroupTuning]") {
+  const TemporaryFile file;
+  const SimulationConfig config;
+
+  {
+    WorkgroupTuning tuning(file.name);
+    tuning.store(deviceProperties(1), config, {64, 64, 64, 64});
+    tuning.store(deviceProperties(2), config, {128, 128, 128, 128});
+    REQUIRE(tuning.save());
+  }
+
+  // the second entry loses its last size
+  std::string contents;
+  {
+    std::ifstream is(file.name);
+    contents.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+  }
+  contents = "# comment\n\n" + contents.substr(0, contents.size() - 5) + "\n";
+  std::ofstream(file.name) << contents;
+
+  const WorkgroupTuning tuning(file.name);
+  CHECK(tuning.find(deviceProperties(1), config) == StepWorkgroupSizes{64, 64, 64, 64});
+  CHECK_FALSE(tuning.find(deviceProperties(2), config).has_value());
+}